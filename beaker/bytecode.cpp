@@ -0,0 +1,650 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "bytecode.hpp"
+#include "type.hpp"
+#include "expr.hpp"
+#include "decl.hpp"
+#include "stmt.hpp"
+
+#include <algorithm>
+
+
+// -------------------------------------------------------------------------- //
+// Programs
+
+// Returns the code for the function f.
+Code*
+Program::code(Function_decl const* f)
+{
+  return &fns[index.find(f)->second];
+}
+
+
+Code const*
+Program::code(Function_decl const* f) const
+{
+  return &fns[index.find(f)->second];
+}
+
+
+// -------------------------------------------------------------------------- //
+// Instruction emission
+
+namespace
+{
+
+// Returns the effect of an operation on the depth of
+// the operand stack. Note that the effect of calls and
+// of spreading an aggregate depends on the number of
+// slots and is accounted for separately.
+int
+effect(Opcode op)
+{
+  switch (op) {
+    case imm_op:
+    case lit_op:
+    case fn_op:
+    case load_op:
+    case gload_op:
+    case addr_op:
+    case gaddr_op:
+      return 1;
+
+    case neg_op:
+    case not_op:
+    case jmp_op:
+    case trap_op:
+    case call_op:
+    case icall_op:
+    case tcall_op:
+    case itcall_op:
+    case field_op:
+    case check_op:
+    case deref_op:
+    case zero_op:
+    case spread_op:
+      return 0;
+
+    case assign_op:
+      return -2;
+
+    default:
+      return -1;
+  }
+}
+
+} // namespace
+
+
+// The state of the innermost loop. Each break is
+// a jump whose target is patched when the exit
+// of the loop is known.
+struct Assembler::Loop
+{
+  Loop(Assembler& a, int c)
+    : assem(a), prev(a.loop), head(c)
+  {
+    assem.loop = this;
+  }
+
+  ~Loop()
+  {
+    assem.loop = prev;
+  }
+
+  Assembler&       assem;
+  Loop*            prev;
+  int              head;   // The target of continue
+  std::vector<int> breaks; // Jumps to the loop exit
+};
+
+
+// Emit an instruction into the current function, and
+// return its index.
+int
+Assembler::emit(Opcode op, Integer_value arg)
+{
+  code->code.push_back({op, arg});
+  depth += effect(op);
+  code->depth = std::max(code->depth, depth);
+  return code->code.size() - 1;
+}
+
+
+// Returns the index of the next instruction.
+int
+Assembler::label() const
+{
+  return code->code.size();
+}
+
+
+// Set the target of the jump at index n.
+void
+Assembler::patch(int n, int target)
+{
+  code->code[n].arg = target;
+}
+
+
+// Push the value of the object declared by d.
+void
+Assembler::load(Decl const* d)
+{
+  if (Variable_decl const* v = as<Variable_decl>(d)) {
+    if (is_global_variable(v))
+      emit(gload_op, v->slot());
+    else
+      emit(load_op, v->slot());
+  } else {
+    emit(load_op, cast<Parameter_decl>(d)->slot());
+  }
+}
+
+
+// Pop a value into the object declared by d.
+void
+Assembler::store(Decl const* d)
+{
+  if (Variable_decl const* v = as<Variable_decl>(d)) {
+    if (is_global_variable(v))
+      emit(gstore_op, v->slot());
+    else
+      emit(store_op, v->slot());
+  } else {
+    emit(store_op, cast<Parameter_decl>(d)->slot());
+  }
+}
+
+
+// Push a reference to the object declared by d.
+void
+Assembler::address(Decl const* d)
+{
+  if (Variable_decl const* v = as<Variable_decl>(d)) {
+    if (is_global_variable(v))
+      emit(gaddr_op, v->slot());
+    else
+      emit(addr_op, v->slot());
+  } else {
+    emit(addr_op, cast<Parameter_decl>(d)->slot());
+  }
+}
+
+
+// Push the argument e of a call, and return the number
+// of slots it occupies. An aggregate argument is spread
+// onto the stack so that it lands in the block of its
+// parameter.
+int
+Assembler::argument(Expr const* e)
+{
+  lower(e);
+  if (!is_aggregate(e->type()))
+    return 1;
+  int n = object_size(e->type());
+  emit(spread_op, n);
+  depth += n - 1;
+  code->depth = std::max(code->depth, depth);
+  return n;
+}
+
+
+// -------------------------------------------------------------------------- //
+// Lowering of declarations
+
+// Lower the module into a program. Functions are indexed
+// before any code is generated so that references to them
+// can be resolved in a single pass. Variables are stored
+// in the slots allocated during elaboration.
+Program
+Assembler::operator()(Module_decl const* m)
+{
+  for (Decl const* d : m->declarations()) {
+    if (Function_decl const* f = as<Function_decl>(d)) {
+      prog.index.emplace(f, prog.fns.size());
+      prog.fns.emplace_back(f);
+    }
+  }
+  prog.globals = m->frame_size();
+
+  // Global initializers are evaluated in the order of
+  // declaration. The initializer returns a dummy value.
+  code = &prog.init;
+  for (Decl const* d : m->declarations())
+    lower(d);
+  emit(imm_op, 0);
+  emit(ret_op);
+
+  for (Code& c : prog.fns)
+    lower(c.fn);
+
+  code = nullptr;
+  return std::move(prog);
+}
+
+
+// Only variables produce code within initializers
+// and function bodies. Functions are lowered after
+// the global initializer, and the remaining
+// declarations have no run-time effect.
+void
+Assembler::lower(Decl const* d)
+{
+  if (Variable_decl const* v = as<Variable_decl>(d))
+    lower(v);
+}
+
+
+// Evaluate the initializer and store it into the slot
+// of the variable. The initializer of an aggregate
+// writes its block, so the resulting reference is
+// discarded.
+void
+Assembler::lower(Variable_decl const* d)
+{
+  lower(d->init());
+  if (is_aggregate(d->type()))
+    emit(pop_op);
+  else
+    store(d);
+}
+
+
+// Parameters occupy the first slots of the frame. Note
+// that we emit a trap at the end of every function
+// since control can flow off the end of its body.
+void
+Assembler::lower(Function_decl const* d)
+{
+  code = prog.code(d);
+  code->parms = parameter_size(d);
+  code->slots = d->frame_size();
+  depth = 0;
+
+  lower(d->body());
+  emit(trap_op);
+}
+
+
+// -------------------------------------------------------------------------- //
+// Lowering of expressions
+
+void
+Assembler::lower(Expr const* e)
+{
+  struct Fn
+  {
+    Assembler& a;
+
+    void operator()(Literal_expr const* e) { a.lower(e); }
+    void operator()(Id_expr const* e) { a.lower(e); }
+    void operator()(Add_expr const* e) { a.lower(e, add_op); }
+    void operator()(Sub_expr const* e) { a.lower(e, sub_op); }
+    void operator()(Mul_expr const* e) { a.lower(e, mul_op); }
+    void operator()(Div_expr const* e) { a.lower(e, div_op); }
+    void operator()(Rem_expr const* e) { a.lower(e, rem_op); }
+    void operator()(Neg_expr const* e) { a.lower(e, neg_op); }
+    void operator()(Pos_expr const* e) { a.lower(e->operand()); }
+    void operator()(Eq_expr const* e) { a.lower(e, eq_op); }
+    void operator()(Ne_expr const* e) { a.lower(e, ne_op); }
+    void operator()(Lt_expr const* e) { a.lower(e, lt_op); }
+    void operator()(Gt_expr const* e) { a.lower(e, gt_op); }
+    void operator()(Le_expr const* e) { a.lower(e, le_op); }
+    void operator()(Ge_expr const* e) { a.lower(e, ge_op); }
+    void operator()(And_expr const* e) { a.lower(e); }
+    void operator()(Or_expr const* e) { a.lower(e); }
+    void operator()(Not_expr const* e) { a.lower(e, not_op); }
+    void operator()(Call_expr const* e) { a.lower(e); }
+    void operator()(Member_expr const* e) { a.lower(e); }
+    void operator()(Index_expr const* e) { a.lower(e); }
+    void operator()(Value_conv const* e) { a.lower(e); }
+    void operator()(Default_init const* e) { a.lower(e); }
+    void operator()(Copy_init const* e) { a.lower(e); }
+  };
+
+  apply(e, Fn{*this});
+}
+
+
+void
+Assembler::lower(Literal_expr const* e)
+{
+  Symbol const* s = e->symbol();
+  if (Boolean_sym const* b = as<Boolean_sym>(s))
+    emit(imm_op, b->value());
+  else if (Integer_sym const* z = as<Integer_sym>(s)) {
+    Integer const& n = z->value();
+    if (n.is_word()) {
+      emit(imm_op, n.word());
+    } else {
+      emit(lit_op, prog.literals.size());
+      prog.literals.push_back(n);
+    }
+  }
+  else
+    throw std::runtime_error("ill-formed literal");
+}
+
+
+// An identifier that names a scalar object loads the
+// value of that object. Because every use of a scalar is
+// eventually converted to a value, the machine needs no
+// reference to it. An aggregate object is referred to
+// by the address of its block.
+void
+Assembler::lower(Id_expr const* e)
+{
+  Decl const* d = e->declaration();
+  if (Function_decl const* f = as<Function_decl>(d))
+    emit(fn_op, prog.index.find(f)->second);
+  else if (is_aggregate(e->type()->nonref()))
+    address(d);
+  else
+    load(d);
+}
+
+
+void
+Assembler::lower(Unary_expr const* e, Opcode op)
+{
+  lower(e->operand());
+  emit(op);
+}
+
+
+void
+Assembler::lower(Binary_expr const* e, Opcode op)
+{
+  lower(e->left());
+  lower(e->right());
+  emit(op);
+}
+
+
+// The right operand is evaluated only if the left
+// operand is true.
+void
+Assembler::lower(And_expr const* e)
+{
+  lower(e->left());
+  int j = emit(and_op);
+  lower(e->right());
+  patch(j, label());
+}
+
+
+// The right operand is evaluated only if the left
+// operand is false.
+void
+Assembler::lower(Or_expr const* e)
+{
+  lower(e->left());
+  int j = emit(or_op);
+  lower(e->right());
+  patch(j, label());
+}
+
+
+// Calls to a named function are resolved statically.
+// All other calls go through a function value. The
+// argument of an indirect call is the number of slots
+// occupied by its arguments. A tail call replaces the
+// current call, and so it has no result.
+void
+Assembler::lower(Call_expr const* e, bool tail)
+{
+  Expr_seq const& args = e->arguments();
+  Id_expr const* id = as<Id_expr>(e->target());
+  int n = 0;
+  if (id && is<Function_decl>(id->declaration())) {
+    Function_decl const* f = cast<Function_decl>(id->declaration());
+    for (Expr const* a : args)
+      n += argument(a);
+    emit(tail ? tcall_op : call_op, prog.index.find(f)->second);
+    depth += (tail ? 0 : 1) - n;
+  } else {
+    lower(e->target());
+    for (Expr const* a : args)
+      n += argument(a);
+    emit(tail ? itcall_op : icall_op, n);
+    depth -= tail ? n + 1 : n;
+  }
+}
+
+
+// A member is at a fixed offset in the block of its
+// record. As in the evaluator, a scalar member of a
+// record value is loaded.
+void
+Assembler::lower(Member_expr const* e)
+{
+  lower(e->object());
+  emit(field_op, e->field()->offset());
+  if (!is<Reference_type>(e->type()) && !is_aggregate(e->type()))
+    emit(deref_op);
+}
+
+
+// The elements of an array are stored contiguously, so
+// the index is scaled by the size of the element. A
+// scalar element of an array value is loaded.
+void
+Assembler::lower(Index_expr const* e)
+{
+  Array_type const* t = cast<Array_type>(e->array()->type()->nonref());
+  lower(e->array());
+  lower(e->index());
+  if (e->checked())
+    emit(check_op, t->extent());
+  emit(index_op, object_size(t->type()));
+  if (!is<Reference_type>(e->type()) && !is_aggregate(e->type()))
+    emit(deref_op);
+}
+
+
+// Identifiers load scalars directly, so only members
+// and elements need to be dereferenced. The value of
+// an aggregate is the reference to its block.
+void
+Assembler::lower(Value_conv const* e)
+{
+  lower(e->source());
+  if (!is_aggregate(e->type()) && !is<Id_expr>(e->source()))
+    emit(deref_op);
+}
+
+
+// Scalar objects are initialized to 0. The block of an
+// aggregate is cleared.
+void
+Assembler::lower(Default_init const* e)
+{
+  if (is_aggregate(e->type())) {
+    address(e->declaration());
+    emit(zero_op, object_size(e->type()));
+  } else {
+    emit(imm_op, 0);
+  }
+}
+
+
+// The initializer of an aggregate is copied into the
+// block of the object.
+void
+Assembler::lower(Copy_init const* e)
+{
+  if (is_aggregate(e->type())) {
+    address(e->declaration());
+    lower(e->value());
+    emit(copy_op, object_size(e->type()));
+  } else {
+    lower(e->value());
+  }
+}
+
+
+// -------------------------------------------------------------------------- //
+// Lowering of statements
+
+void
+Assembler::lower(Stmt const* s)
+{
+  struct Fn
+  {
+    Assembler& a;
+
+    void operator()(Empty_stmt const* s) { }
+    void operator()(Block_stmt const* s) { a.lower(s); }
+    void operator()(Assign_stmt const* s) { a.lower(s); }
+    void operator()(Return_stmt const* s) { a.lower(s); }
+    void operator()(If_then_stmt const* s) { a.lower(s); }
+    void operator()(If_else_stmt const* s) { a.lower(s); }
+    void operator()(While_stmt const* s) { a.lower(s); }
+    void operator()(Break_stmt const* s) { a.lower(s); }
+    void operator()(Continue_stmt const* s) { a.lower(s); }
+    void operator()(Expression_stmt const* s) { a.lower(s); }
+    void operator()(Declaration_stmt const* s) { a.lower(s); }
+  };
+
+  apply(s, Fn{*this});
+}
+
+
+void
+Assembler::lower(Block_stmt const* s)
+{
+  for (Stmt const* s1 : s->statements())
+    lower(s1);
+}
+
+
+// A scalar variable or parameter is stored directly.
+// Any other object is assigned through its reference.
+void
+Assembler::lower(Assign_stmt const* s)
+{
+  Expr const* obj = s->object();
+  Type const* t = s->value()->type();
+  Id_expr const* id = as<Id_expr>(obj);
+  if (id && !is_aggregate(t)) {
+    lower(s->value());
+    store(id->declaration());
+    return;
+  }
+
+  lower(obj);
+  lower(s->value());
+  if (is_aggregate(t)) {
+    emit(copy_op, object_size(t));
+    emit(pop_op);
+  } else {
+    emit(assign_op);
+  }
+}
+
+
+// An aggregate result is copied out of the frame,
+// which the caller reuses for its operands. As in the
+// evaluator, a returned call is a tail call.
+void
+Assembler::lower(Return_stmt const* s)
+{
+  if (Call_expr const* c = as<Call_expr>(s->value())) {
+    if (c->tail()) {
+      lower(c, true);
+      return;
+    }
+  }
+  lower(s->value());
+  Type const* t = s->value()->type();
+  if (is_aggregate(t)) {
+    int n = object_size(t);
+    prog.result = std::max(prog.result, n);
+    emit(aret_op, n);
+  } else {
+    emit(ret_op);
+  }
+}
+
+
+void
+Assembler::lower(If_then_stmt const* s)
+{
+  lower(s->condition());
+  int j = emit(jf_op);
+  lower(s->body());
+  patch(j, label());
+}
+
+
+void
+Assembler::lower(If_else_stmt const* s)
+{
+  lower(s->condition());
+  int j1 = emit(jf_op);
+  lower(s->true_branch());
+  int j2 = emit(jmp_op);
+  patch(j1, label());
+  lower(s->false_branch());
+  patch(j2, label());
+}
+
+
+// The condition is evaluated at the head of the loop.
+// Continues jump to the head, and breaks jump to the
+// exit.
+void
+Assembler::lower(While_stmt const* s)
+{
+  Loop l(*this, label());
+  lower(s->condition());
+  int j = emit(jf_op);
+  lower(s->body());
+  emit(jmp_op, l.head);
+
+  int exit = label();
+  patch(j, exit);
+  for (int b : l.breaks)
+    patch(b, exit);
+}
+
+
+// A break outside of a loop terminates the function
+// abnormally.
+void
+Assembler::lower(Break_stmt const* s)
+{
+  if (loop)
+    loop->breaks.push_back(emit(jmp_op));
+  else
+    emit(trap_op);
+}
+
+
+// A continue outside of a loop terminates the function
+// abnormally.
+void
+Assembler::lower(Continue_stmt const* s)
+{
+  if (loop)
+    emit(jmp_op, loop->head);
+  else
+    emit(trap_op);
+}
+
+
+void
+Assembler::lower(Expression_stmt const* s)
+{
+  lower(s->expression());
+  emit(pop_op);
+}
+
+
+void
+Assembler::lower(Declaration_stmt const* s)
+{
+  lower(s->declaration());
+}
@@ -0,0 +1,210 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef BEAKER_BYTECODE_HPP
+#define BEAKER_BYTECODE_HPP
+
+// The bytecode module defines a compact, linear
+// instruction set for the interpretation of Beaker
+// programs, and the assembler that lowers elaborated
+// declarations into that instruction set.
+//
+// The bytecode is stack-based. Each function is lowered
+// to a sequence of instructions that manipulate a
+// operand stack. Parameters and local variables are
+// accessed through the frame slots allocated during
+// elaboration, and globals through the slots of the
+// module's frame. Control flow is lowered to jumps with
+// absolute targets.
+
+#include "prelude.hpp"
+#include "value.hpp"
+
+#include <unordered_map>
+#include <vector>
+
+
+struct Unary_expr;
+struct Binary_expr;
+
+
+// The operations of the bytecode machine. The effect of
+// each operation on the operand stack is given in the
+// comment. The argument of the instruction is n.
+enum Opcode
+{
+  imm_op,     // push the integer n
+  lit_op,     // push the integer literal n of the program
+  fn_op,      // push the function n
+  load_op,    // push the local in slot n
+  store_op,   // pop into the local in slot n
+  gload_op,   // push the global in slot n
+  gstore_op,  // pop into the global in slot n
+  addr_op,    // push a reference to the local in slot n
+  gaddr_op,   // push a reference to the global in slot n
+  field_op,   // r -> r + n
+  check_op,   // r i -> r i, trapping unless 0 <= i < n
+  index_op,   // r i -> r + i * n
+  deref_op,   // r -> *r
+  assign_op,  // r v -> ; *r = v
+  copy_op,    // d s -> d, copying the n slots of s into d
+  zero_op,    // r -> r, clearing the n slots of r
+  spread_op,  // r -> v1 ... vn, the n slots of r
+  pop_op,     // discard the top of the stack
+  add_op,     // a b -> a + b
+  sub_op,     // a b -> a - b
+  mul_op,     // a b -> a * b
+  div_op,     // a b -> a / b
+  rem_op,     // a b -> a % b
+  neg_op,     // a -> -a
+  not_op,     // a -> !a
+  eq_op,      // a b -> a == b
+  ne_op,      // a b -> a != b
+  lt_op,      // a b -> a < b
+  gt_op,      // a b -> a > b
+  le_op,      // a b -> a <= b
+  ge_op,      // a b -> a >= b
+  jmp_op,     // jump to n
+  jf_op,      // pop; jump to n if false
+  and_op,     // jump to n if the top is false, otherwise pop
+  or_op,      // jump to n if the top is true, otherwise pop
+  call_op,    // a1 ... ak -> r, calling function n
+  icall_op,   // f a1 ... an -> r, calling f with n arguments
+  tcall_op,   // a1 ... ak ->, replacing this call with function n
+  itcall_op,  // f a1 ... an ->, replacing this call with f
+  ret_op,     // return the top of the stack
+  aret_op,    // return the n slots referred to by the top
+  trap_op,    // flowing off the end of a function
+};
+
+
+// Aggregate objects occupy consecutive slots of a frame
+// or of the globals, and their values are references to
+// those blocks. An aggregate is copied by the operation
+// that consumes it: copy_op for initialization and
+// assignment, and spread_op for the arguments of a call.
+
+
+// An instruction is an operation and its argument.
+// Note that the argument of imm_op is an integer value.
+// Integer literals that do not fit in a word are stored
+// in the program, and pushed by lit_op.
+struct Instruction
+{
+  Opcode        op;
+  Integer_value arg;
+};
+
+
+using Instruction_seq = std::vector<Instruction>;
+
+
+// The code for a single function. Note that parameters
+// occupy the first slots of the frame, followed by the
+// slots of all local variables. The number of parameters
+// is the number of slots they occupy.
+struct Code
+{
+  Code(Function_decl const* f)
+    : fn(f), parms(0), slots(0), depth(0)
+  { }
+
+  Function_decl const* fn;    // The lowered function
+  int                  parms; // Slots of the parameters
+  int                  slots; // Size of the frame
+  int                  depth; // Maximum operand stack depth
+  Instruction_seq      code;
+};
+
+
+// A lowered program. This contains the code for every
+// function in a module and the initializer for its
+// global variables. Functions are indexed in the order
+// of their declaration. An aggregate returned by a call
+// is copied into the machine's result block, which must
+// hold the largest such aggregate.
+struct Program
+{
+  Program()
+    : init(nullptr), globals(0), result(0)
+  { }
+
+  Code*       code(Function_decl const*);
+  Code const* code(Function_decl const*) const;
+
+  Code                 init;     // Global initialization
+  std::vector<Code>    fns;      // Function definitions
+  std::vector<Integer> literals; // Large integer literals
+  int                  globals;  // Number of globals
+  int                  result;   // Size of the result block
+
+  std::unordered_map<Function_decl const*, int> index;
+};
+
+
+// The assembler lowers a module into a program. Note
+// that the assembler is only valid over elaborated
+// declarations.
+class Assembler
+{
+public:
+  Program operator()(Module_decl const*);
+
+  void lower(Decl const*);
+  void lower(Variable_decl const*);
+  void lower(Function_decl const*);
+
+  void lower(Expr const*);
+  void lower(Literal_expr const*);
+  void lower(Id_expr const*);
+  void lower(Unary_expr const*, Opcode);
+  void lower(Binary_expr const*, Opcode);
+  void lower(And_expr const*);
+  void lower(Or_expr const*);
+  void lower(Call_expr const*, bool = false);
+  void lower(Member_expr const*);
+  void lower(Index_expr const*);
+  void lower(Value_conv const*);
+  void lower(Default_init const*);
+  void lower(Copy_init const*);
+
+  void lower(Stmt const*);
+  void lower(Block_stmt const*);
+  void lower(Assign_stmt const*);
+  void lower(Return_stmt const*);
+  void lower(If_then_stmt const*);
+  void lower(If_else_stmt const*);
+  void lower(While_stmt const*);
+  void lower(Break_stmt const*);
+  void lower(Continue_stmt const*);
+  void lower(Expression_stmt const*);
+  void lower(Declaration_stmt const*);
+
+private:
+  struct Loop;
+
+  int  emit(Opcode, Integer_value = 0);
+  int  label() const;
+  void patch(int, int);
+  void load(Decl const*);
+  void store(Decl const*);
+  void address(Decl const*);
+  int  argument(Expr const*);
+
+  Program prog;
+  Code*   code = nullptr;  // The function being lowered
+  int     depth = 0;       // The current operand stack depth
+  Loop*   loop = nullptr;  // The innermost loop
+};
+
+
+// Lower the module m into a program.
+inline Program
+assemble(Module_decl const* m)
+{
+  Assembler a;
+  return a(m);
+}
+
+
+#endif
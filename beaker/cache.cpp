@@ -0,0 +1,255 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "cache.hpp"
+
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Support/Chrono.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/Process.h>
+#include <llvm/Support/SHA256.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+
+namespace
+{
+
+// Throw an error about the file f when ec is set.
+void
+check(std::error_code ec, String const& what, String const& f)
+{
+  if (ec)
+    throw std::runtime_error("cannot " + what + " '" + f + "': " + ec.message());
+}
+
+
+// Returns true if the file name n is that of an entry:
+// a hash in hexadecimal.
+bool
+is_entry(llvm::StringRef n)
+{
+  return n.size() == 64 && std::all_of(n.begin(), n.end(), llvm::isHexDigit);
+}
+
+} // namespace
+
+
+// Holds the lock of the cache for its lifetime.
+struct Compile_cache::Lock
+{
+  Lock(String const& dir)
+  {
+    String f = dir + "/lock";
+    check(llvm::sys::fs::openFileForWrite(f, fd, llvm::sys::fs::CD_OpenAlways),
+          "open", f);
+    check(llvm::sys::fs::lockFile(fd), "lock", f);
+  }
+
+  ~Lock()
+  {
+    llvm::sys::fs::unlockFile(fd);
+    llvm::sys::Process::SafelyCloseFileDescriptor(fd);
+  }
+
+  int fd;
+};
+
+
+// Open the cache in the directory dir, creating it if
+// needed. Entries are removed when their total size
+// exceeds n bytes.
+Compile_cache::Compile_cache(String const& dir, std::uint64_t n)
+  : dir_(dir), limit_(n), hits_(0), misses_(0), evictions_(0)
+{
+  check(llvm::sys::fs::create_directories(dir), "create", dir);
+}
+
+
+// Returns the key of the output for the source text src
+// compiled with the options opts. Options shall include
+// everything, other than the source, that determines the
+// output.
+String
+Compile_cache::key(String const& src, String const& opts) const
+{
+  llvm::SHA256 h;
+  h.update(opts);
+  h.update(llvm::StringRef("\0", 1));
+  h.update(src);
+  return llvm::toHex(h.final(), true);
+}
+
+
+// If the cache has an entry for the key k, write it to
+// the file out ("-" is standard output) and return true.
+// Otherwise, return false.
+bool
+Compile_cache::find(String const& k, String const& out)
+{
+  Lock lock(dir_);
+  load();
+  String f = entry(k);
+  bool hit = llvm::sys::fs::exists(f);
+  if (hit) {
+    // Mark the entry as used now.
+    int fd;
+    if (!llvm::sys::fs::openFileForWrite(f, fd, llvm::sys::fs::CD_OpenExisting,
+                                         llvm::sys::fs::OF_Append)) {
+      llvm::sys::fs::setLastAccessAndModificationTime(fd, std::chrono::system_clock::now());
+      llvm::sys::Process::SafelyCloseFileDescriptor(fd);
+    }
+    copy(f, out);
+    ++hits_;
+  } else {
+    ++misses_;
+  }
+  save();
+  return hit;
+}
+
+
+// Returns the name of a new, empty file in the cache
+// directory, where an output can be written before it
+// is inserted.
+String
+Compile_cache::temporary()
+{
+  llvm::SmallString<128> f;
+  check(llvm::sys::fs::createUniqueFile(dir_ + "/tmp-%%%%%%%%", f), "create", dir_);
+  return f.str().str();
+}
+
+
+// Make the temporary file tmp the entry for the key k,
+// and write it to the file out. Then, remove the least
+// recently used entries, other than this one, until the
+// cache is within its limit.
+void
+Compile_cache::insert(String const& k, String const& tmp, String const& out)
+{
+  Lock lock(dir_);
+  String f = entry(k);
+  check(llvm::sys::fs::rename(tmp, f), "rename", tmp);
+  copy(f, out);
+  load();
+  evict(k);
+  save();
+}
+
+
+// Write the statistics of the cache to os.
+void
+Compile_cache::report(std::ostream& os)
+{
+  Lock lock(dir_);
+  load();
+  std::uint64_t size = 0;
+  std::size_t n = 0;
+  std::error_code ec;
+  for (llvm::sys::fs::directory_iterator i(dir_, ec), e; i != e && !ec; i.increment(ec)) {
+    if (!is_entry(llvm::sys::path::filename(i->path())))
+      continue;
+    llvm::ErrorOr<llvm::sys::fs::basic_file_status> st = i->status();
+    if (st) {
+      size += st->getSize();
+      ++n;
+    }
+  }
+  os << "cache: " << hits_ << " hits, "
+     << misses_ << " misses, "
+     << evictions_ << " evictions, "
+     << size << " of " << limit_ << " bytes in "
+     << n << " entries\n";
+}
+
+
+String
+Compile_cache::entry(String const& k) const
+{
+  return dir_ + '/' + k;
+}
+
+
+// Write the file f to the file out.
+void
+Compile_cache::copy(String const& f, String const& out)
+{
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> buf =
+    llvm::MemoryBuffer::getFile(f, false, false);
+  check(buf.getError(), "read", f);
+  std::error_code ec;
+  llvm::raw_fd_ostream os(out, ec, llvm::sys::fs::OF_None);
+  check(ec, "open", out);
+  os << (*buf)->getBuffer();
+}
+
+
+// Read the statistics of the cache. A missing or
+// damaged file counts nothing.
+void
+Compile_cache::load()
+{
+  hits_ = misses_ = evictions_ = 0;
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> buf =
+    llvm::MemoryBuffer::getFile(dir_ + "/stats");
+  if (!buf)
+    return;
+  std::istringstream is((*buf)->getBuffer().str());
+  if (!(is >> hits_ >> misses_ >> evictions_))
+    hits_ = misses_ = evictions_ = 0;
+}
+
+
+void
+Compile_cache::save()
+{
+  String f = dir_ + "/stats";
+  std::error_code ec;
+  llvm::raw_fd_ostream os(f, ec, llvm::sys::fs::OF_Text);
+  check(ec, "open", f);
+  os << hits_ << ' ' << misses_ << ' ' << evictions_ << '\n';
+}
+
+
+// Remove entries, least recently used first, until the
+// total size of the cache is within its limit. The entry
+// for the key k is kept.
+void
+Compile_cache::evict(String const& k)
+{
+  using Entry = std::tuple<llvm::sys::TimePoint<>, std::uint64_t, String>;
+  std::vector<Entry> es;
+  std::uint64_t size = 0;
+  std::error_code ec;
+  for (llvm::sys::fs::directory_iterator i(dir_, ec), e; i != e && !ec; i.increment(ec)) {
+    llvm::StringRef n = llvm::sys::path::filename(i->path());
+    if (!is_entry(n))
+      continue;
+    llvm::sys::fs::file_status st;
+    if (llvm::sys::fs::status(i->path(), st))
+      continue;
+    size += st.getSize();
+    if (n != k)
+      es.emplace_back(st.getLastModificationTime(), st.getSize(), i->path());
+  }
+
+  std::sort(es.begin(), es.end());
+  for (Entry const& e : es) {
+    if (size <= limit_)
+      break;
+    if (!llvm::sys::fs::remove(std::get<2>(e))) {
+      size -= std::get<1>(e);
+      ++evictions_;
+    }
+  }
+}
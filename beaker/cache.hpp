@@ -0,0 +1,62 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef BEAKER_CACHE_HPP
+#define BEAKER_CACHE_HPP
+
+#include "prelude.hpp"
+
+#include <cstdint>
+#include <iosfwd>
+
+
+// The compile cache is a directory of compiler outputs.
+// Each entry is named by a hash of the source text of a
+// program and of the options that determine the output,
+// so that an unchanged program is never compiled twice.
+//
+// The modification time of an entry is the time that it
+// was last used. When the entries exceed the size limit
+// of the cache, the least recently used are removed. The
+// numbers of hits, misses, and evictions are kept in the
+// directory, so they accumulate over runs. Compilers that
+// share a cache take turns by locking a file in it.
+class Compile_cache
+{
+public:
+  static constexpr std::uint64_t default_limit = std::uint64_t(1) << 30;
+
+  Compile_cache(String const&, std::uint64_t = default_limit);
+
+  String key(String const&, String const&) const;
+
+  bool   find(String const&, String const&);
+  String temporary();
+  void   insert(String const&, String const&, String const&);
+
+  void report(std::ostream&);
+
+  // Statistics
+  std::uint64_t limit() const     { return limit_; }
+  std::uint64_t hits() const      { return hits_; }
+  std::uint64_t misses() const    { return misses_; }
+  std::uint64_t evictions() const { return evictions_; }
+
+private:
+  struct Lock;
+
+  String entry(String const&) const;
+  void   copy(String const&, String const&);
+  void   load();
+  void   save();
+  void   evict(String const&);
+
+  String        dir_;
+  std::uint64_t limit_;
+  std::uint64_t hits_;
+  std::uint64_t misses_;
+  std::uint64_t evictions_;
+};
+
+
+#endif
@@ -7,19 +7,45 @@
 #include <cassert>
 
 
+// The node hierarchies (expressions, statements,
+// declarations, and types) store the kind of each node.
+// A class U in those hierarchies defines the static
+// member function U::classof, which determines from the
+// kind of a node whether it is a U. When that member is
+// available, as<U> compares kinds instead of performing
+// a dynamic cast. Classes without that member (e.g.,
+// symbols) fall back to dynamic_cast.
+
+
+template<typename U, typename T>
+inline auto
+as_kind(T* t, int) -> decltype(U::classof(t), static_cast<U*>(t))
+{
+  return t && U::classof(t) ? static_cast<U*>(t) : nullptr;
+}
+
+
 template<typename U, typename T>
 inline U*
-as(T* t)
+as_kind(T* t, long)
 {
   return dynamic_cast<U*>(t);
 }
 
 
+template<typename U, typename T>
+inline U*
+as(T* t)
+{
+  return as_kind<U>(t, 0);
+}
+
+
 template<typename U, typename T>
 inline U const*
 as(T const* t)
 {
-  return dynamic_cast<U const*>(t);
+  return as_kind<U const>(t, 0);
 }
 
 
@@ -27,7 +53,7 @@ template<typename U, typename T>
 inline bool
 is(T const* t)
 {
-  return dynamic_cast<U const*>(t);
+  return as_kind<U const>(t, 0);
 }
 
 
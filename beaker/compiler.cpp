@@ -4,19 +4,72 @@
 #include "lexer.hpp"
 #include "parser.hpp"
 #include "elaborator.hpp"
+#include "fold.hpp"
 #include "generator.hpp"
+#include "optimizer.hpp"
+#include "target.hpp"
+#include "cache.hpp"
 #include "error.hpp"
 
+#include <cstdlib>
 #include <iostream>
 #include <fstream>
+#include <memory>
+#include <sstream>
 
+#include <llvm/Config/llvm-config.h>
 #include <llvm/IR/Module.h>
+#include <llvm/Support/FileSystem.h>
 #include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetMachine.h>
 
 
 using namespace std;
 
 
+namespace
+{
+
+// Parse a size in bytes, optionally followed by K, M,
+// or G. Returns 0 if s is not a size.
+std::uint64_t
+parse_size(String const& s)
+{
+  char* end;
+  std::uint64_t n = std::strtoull(s.c_str(), &end, 10);
+  String unit = end;
+  if (unit == "K")
+    n <<= 10;
+  else if (unit == "M")
+    n <<= 20;
+  else if (unit == "G")
+    n <<= 30;
+  else if (!unit.empty())
+    return 0;
+  return n;
+}
+
+
+// Returns a description of this program that changes
+// whenever it is rebuilt: its path, size, and time of
+// modification.
+String
+identity(char const* argv0)
+{
+  static int anchor;
+  String exe = llvm::sys::fs::getMainExecutable(argv0, &anchor);
+  llvm::sys::fs::file_status st;
+  std::ostringstream ss;
+  ss << exe;
+  if (!llvm::sys::fs::status(exe, st))
+    ss << ' ' << st.getSize() << ' '
+       << st.getLastModificationTime().time_since_epoch().count();
+  return ss.str();
+}
+
+} // namespace
+
+
 int
 main(int argc, char* argv[])
 {
@@ -24,10 +77,199 @@ main(int argc, char* argv[])
   Symbol_table syms;
   init_symbols(syms);
 
-  // Prepare the input buffer.
+  // Parse command line options. The input file is the
+  // first argument that is not an option.
+  //
+  //    --unchecked
+  //             Integer arithmetic wraps on overflow
+  //             instead of trapping.
+  //
+  //    -O0, -O1, -O2, -O3
+  //             Run the optimization pipeline of the given
+  //             level. The default is -O0.
+  //
+  //    --time-passes
+  //             Report the time taken by each optimization
+  //             pass to standard error.
+  //
+  //    -g       Describe the source lines of functions in
+  //             DWARF line tables, so that debuggers and
+  //             profilers can attribute code to them.
+  //
+  //    --threads=N
+  //             Generate and optimize function bodies on N
+  //             threads. The output does not depend on N.
+  //
+  //    -c       Write an object file. With -emit-llvm,
+  //             write LLVM bitcode.
+  //
+  //    -S       Write an assembly file. With -emit-llvm,
+  //             write LLVM IR.
+  //
+  //    -o file  Write the output to file ("-" is standard
+  //             output). With -c or -S, the default is the
+  //             input file with a .o, .s, .bc, or .ll
+  //             extension. Otherwise, LLVM IR is written to
+  //             standard output.
+  //
+  //    -march=arch
+  //             Generate code for the architecture arch.
+  //             The default is the host.
+  //
+  //    -mcpu=cpu
+  //             Generate code for the processor cpu. With
+  //             -mcpu=native, code is tuned for the host.
+  //
+  //    --cache=dir
+  //             Keep outputs in the cache directory dir,
+  //             keyed by the source and the options that
+  //             determine the output. A program found there
+  //             is not compiled again.
   //
-  // FIXME: Handle command line arguments.
-  File src = argv[1];
+  //    --cache-size=N
+  //             Limit the cache to N bytes (or N K, M, or G
+  //             bytes), removing the least recently used
+  //             outputs. The default is 1G.
+  //
+  //    --cache-stats
+  //             Report the hits, misses, evictions, and size
+  //             of the cache to standard error.
+  Arithmetic arith = checked_arithmetic;
+  Optimizer opt;
+  int threads = 1;
+  Output_format format = ir_format;
+  bool native = false;
+  bool llvm_ir = false;
+  bool debug = false;
+  String output;
+  String arch;
+  String cpu;
+  String cache_dir;
+  std::uint64_t cache_size = Compile_cache::default_limit;
+  bool cache_stats = false;
+  char const* input = nullptr;
+  for (int i = 1; i < argc; ++i) {
+    String arg = argv[i];
+    if (arg == "--unchecked") {
+      arith = wrapping_arithmetic;
+    } else if (arg.size() == 3 && arg[0] == '-' && arg[1] == 'O'
+                               && '0' <= arg[2] && arg[2] <= '3') {
+      opt.level = arg[2] - '0';
+    } else if (arg == "--time-passes") {
+      opt.timing = true;
+    } else if (arg.compare(0, 10, "--threads=") == 0) {
+      threads = std::atoi(arg.c_str() + 10);
+      if (threads <= 0) {
+        std::cerr << "error: invalid thread count '" << arg << "'\n";
+        return -1;
+      }
+    } else if (arg == "-c") {
+      format = object_format;
+      native = true;
+    } else if (arg == "-S") {
+      format = assembly_format;
+      native = true;
+    } else if (arg == "-emit-llvm") {
+      llvm_ir = true;
+    } else if (arg == "-o" && i + 1 < argc) {
+      output = argv[++i];
+    } else if (arg.compare(0, 7, "-march=") == 0) {
+      arch = arg.substr(7);
+    } else if (arg.compare(0, 6, "-mcpu=") == 0) {
+      cpu = arg.substr(6);
+    } else if (arg == "-g") {
+      debug = true;
+    } else if (arg.compare(0, 8, "--cache=") == 0) {
+      cache_dir = arg.substr(8);
+    } else if (arg.compare(0, 13, "--cache-size=") == 0) {
+      cache_size = parse_size(arg.substr(13));
+      if (cache_size == 0) {
+        std::cerr << "error: invalid cache size '" << arg << "'\n";
+        return -1;
+      }
+    } else if (arg == "--cache-stats") {
+      cache_stats = true;
+    } else if (arg[0] == '-' && arg != "-") {
+      std::cerr << "error: unknown option '" << arg << "'\n";
+      return -1;
+    } else {
+      input = argv[i];
+    }
+  }
+  if (!input) {
+    std::cerr << "usage: beaker-compile [--unchecked] [-O0 | -O1 | -O2 | -O3] "
+                 "[--time-passes] [--threads=N] [-g] [-c | -S] [-emit-llvm] [-o file] "
+                 "[-march=arch] [-mcpu=cpu] [--cache=dir] [--cache-size=N] "
+                 "[--cache-stats] input.bkr\n";
+    return -1;
+  }
+  if (llvm_ir)
+    format = format == object_format ? bitcode_format : ir_format;
+  if (output.empty()) {
+    if (native) {
+      static char const* exts[] = { ".ll", ".bc", ".s", ".o" };
+      output = input;
+      std::size_t n = output.rfind('.');
+      if (n != String::npos && output.find('/', n) == String::npos)
+        output.erase(n);
+      output += exts[format];
+    } else {
+      output = "-";
+    }
+  }
+
+  // Configure code generation for the target.
+  std::unique_ptr<llvm::TargetMachine> target;
+  try {
+    target = make_target(arch, cpu, opt.level);
+  } catch (std::runtime_error& err) {
+    std::cerr << "error: " << err.what() << '\n';
+    return -1;
+  }
+  opt.target = target.get();
+
+  // Look for the output in the cache. The key covers the
+  // source and everything else that determines the output,
+  // including the compiler itself. On a hit, the program
+  // is not compiled at all.
+  std::unique_ptr<Compile_cache> cache;
+  String key;
+  if (!cache_dir.empty()) {
+    std::ifstream f(input, std::ios::binary);
+    if (!f) {
+      std::cerr << "error: cannot read '" << input << "'\n";
+      return -1;
+    }
+    std::ostringstream src;
+    src << f.rdbuf();
+
+    std::ostringstream opts;
+    opts << "compiler " << identity(argv[0]) << '\n'
+         << "llvm " << LLVM_VERSION_STRING << '\n'
+         << "arithmetic " << arith << '\n'
+         << "level " << opt.level << '\n'
+         << "format " << format << '\n'
+         << "target " << target->getTargetTriple().str() << ' '
+                      << target->getTargetCPU().str() << ' '
+                      << target->getTargetFeatureString().str() << '\n';
+    if (debug)
+      opts << "debug " << File(input).pathname() << '\n';
+    try {
+      cache.reset(new Compile_cache(cache_dir, cache_size));
+      key = cache->key(src.str(), opts.str());
+      if (cache->find(key, output)) {
+        if (cache_stats)
+          cache->report(std::cerr);
+        return 0;
+      }
+    } catch (std::runtime_error& err) {
+      std::cerr << "error: " << err.what() << '\n';
+      return -1;
+    }
+  }
+
+  // Prepare the input buffer.
+  File src = input;
   Input_buffer in = src;
 
   try {
@@ -42,7 +284,8 @@ main(int argc, char* argv[])
 
     // Build and run the parser. The location map
     // is used to save source locations, which are
-    // used to diagnose elaboration errors.
+    // used to diagnose elaboration errors, and to
+    // describe source lines in debug information.
     Location_map locs;
     Parser parse(syms, ts, locs);
     Decl* m = parse.module();
@@ -55,12 +298,45 @@ main(int argc, char* argv[])
     Elaborator elab(locs);
     elab.elaborate(m);
 
+    // Replace constant expressions with literals.
+    Folder folder(syms);
+    folder.fold(m);
+
     // Translate to LLVM.
     //
     // TODO: Support translation to other models?
     Generator gen;
+    gen.arith = arith;
+    gen.level = opt.level;
+    gen.threads = threads;
+    if (debug)
+      gen.locs = &locs;
     llvm::Module* mod = gen(m);
-    llvm::outs() << *mod;
+    configure(mod, target.get());
+
+    // Optimize the module.
+    opt(mod);
+
+    // Write the output. With a cache, it is written to a
+    // new entry first, and copied from there.
+    String file = cache ? cache->temporary() : output;
+    {
+      std::error_code ec;
+      llvm::sys::fs::OpenFlags flags = format == ir_format || format == assembly_format
+                                     ? llvm::sys::fs::OF_Text
+                                     : llvm::sys::fs::OF_None;
+      llvm::raw_fd_ostream os(file, ec, flags);
+      if (ec) {
+        std::cerr << "error: cannot open '" << file << "': " << ec.message() << '\n';
+        return -1;
+      }
+      emit(mod, target.get(), format, os);
+    }
+    if (cache) {
+      cache->insert(key, file, output);
+      if (cache_stats)
+        cache->report(std::cerr);
+    }
   }
 
   // Diagnose uncaught translation errors and exit
@@ -73,5 +349,11 @@ main(int argc, char* argv[])
     return -1;
   }
 
+  // The cache could not be updated.
+  catch (std::runtime_error& err) {
+    std::cerr << "error: " << err.what() << '\n';
+    return -1;
+  }
+
   // FIXME: Do something with the module.
 }
@@ -18,3 +18,32 @@ Function_decl::return_type() const
   return type()->return_type();
 }
 
+
+// Returns the number of slots occupied by an object
+// of type t. A record occupies the slots of its block,
+// an array occupies the slots of its elements, and every
+// other object occupies a single slot.
+int
+object_size(Type const* t)
+{
+  if (Record_type const* r = as<Record_type>(t))
+    return r->declaration()->size();
+  if (Array_type const* a = as<Array_type>(t))
+    return a->extent() * object_size(a->type());
+  return 1;
+}
+
+
+// Returns the number of slots occupied by the
+// parameters of f. These are the first slots of
+// its frame.
+int
+parameter_size(Function_decl const* f)
+{
+  Decl_seq const& parms = f->parameters();
+  if (parms.empty())
+    return 0;
+  Parameter_decl const* p = cast<Parameter_decl>(parms.back());
+  return p->slot() + object_size(p->type());
+}
+
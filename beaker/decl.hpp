@@ -17,8 +17,19 @@ struct Decl
   struct Visitor;
   struct Mutator;
 
-  Decl(Symbol const* s, Type const* t)
-    : name_(s), type_(t)
+  // The kinds of declarations.
+  enum Kind
+  {
+    variable_decl,
+    function_decl,
+    parameter_decl,
+    record_decl,
+    field_decl,
+    module_decl,
+  };
+
+  Decl(Kind k, Symbol const* s, Type const* t)
+    : kind_(k), name_(s), type_(t)
   { }
 
   virtual ~Decl() { }
@@ -26,10 +37,12 @@ struct Decl
   virtual void accept(Visitor&) const = 0;
   virtual void accept(Mutator&) = 0;
 
+  Kind          kind() const { return kind_; }
   Decl const*   context() const { return cxt_; }
   Symbol const* name() const { return name_; }
   Type const*   type() const { return type_; }
 
+  Kind          kind_;
   Decl const*   cxt_;
   Symbol const* name_;
   Type const*   type_;
@@ -61,29 +74,66 @@ struct Decl::Mutator
 
 
 // Represents variable declarations.
+//
+// Every variable is assigned a slot during elaboration.
+// Local variables occupy a slot in the frame of their
+// enclosing function, and global variables occupy a
+// slot in the frame of their module.
 struct Variable_decl : Decl
 {
   Variable_decl(Symbol const* n, Type const* t, Expr* e)
-    : Decl(n, t), init_(e)
+    : Decl(variable_decl, n, t), init_(e), slot_(-1)
   { }
 
+  static bool classof(Decl const* d) { return d->kind() == variable_decl; }
+
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
 
   Expr const* init() const { return init_; }
   Expr*       init()       { return init_; }
 
+  int slot() const { return slot_; }
+
   Expr* init_;
+  int   slot_;
 };
 
 
 // Represents function declarations.
+//
+// The frame size is the number of slots needed to
+// store the parameters and local variables of the
+// function. Parameters occupy the first slots of the
+// frame. Variables in disjoint blocks may share slots.
+//
+// A function is pure when it neither reads nor writes
+// global variables, and only calls pure functions by
+// name. The result of a call to a pure function depends
+// only on its arguments. A function is read-only when
+// it does not write global variables, and only calls
+// read-only functions by name.
+//
+// A call to a function does not unwind when it cannot
+// reach a runtime check: the function has none, and only
+// calls functions that do not unwind by name. (A failed
+// check ends a compiled program, but in the JIT, it
+// unwinds to the interpreter.) A call is non-recursive
+// when it cannot reach the function again, and always
+// returns when the function is non-recursive, has no
+// loops or runtime checks, and only calls functions that
+// always return. These facts are inferred from the call
+// graph of the module during elaboration.
 struct Function_decl : Decl
 {
   Function_decl(Symbol const* n, Type const* t, Decl_seq const& p, Stmt* b)
-    : Decl(n, t), parms_(p), body_(b)
+    : Decl(function_decl, n, t), parms_(p), body_(b), frame_(0),
+      pure_(true), readonly_(true), nounwind_(true), norecurse_(true),
+      willreturn_(true)
   { }
 
+  static bool classof(Decl const* d) { return d->kind() == function_decl; }
+
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
 
@@ -95,60 +145,112 @@ struct Function_decl : Decl
   Stmt const* body() const { return body_; }
   Stmt*       body()       { return body_; }
 
+  int  frame_size() const { return frame_; }
+  bool pure() const       { return pure_; }
+  bool readonly() const   { return readonly_; }
+  bool nounwind() const   { return nounwind_; }
+  bool norecurse() const  { return norecurse_; }
+  bool willreturn() const { return willreturn_; }
+
   Decl_seq parms_;
   Stmt*    body_;
+  int      frame_;
+  bool     pure_;
+  bool     readonly_;
+  bool     nounwind_;
+  bool     norecurse_;
+  bool     willreturn_;
 };
 
 
-// Represents parameter declarations.
+// Represents parameter declarations. Each parameter
+// is assigned a slot in the frame of its function
+// during elaboration.
 struct Parameter_decl : Decl
 {
-  using Decl::Decl;
+  Parameter_decl(Symbol const* n, Type const* t)
+    : Decl(parameter_decl, n, t), slot_(-1)
+  { }
+
+  static bool classof(Decl const* d) { return d->kind() == parameter_decl; }
 
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
+
+  int slot() const { return slot_; }
+
+  int slot_;
 };
 
 
 // Declares a user-defined record type.
+//
+// A record object is laid out as a contiguous block of
+// slots. Each field occupies a fixed range of slots at
+// an offset from the start of the block; a field of
+// record type occupies that record's block. The layout
+// is computed once, during elaboration. The size of a
+// record is the number of slots in its block, which is
+// never 0.
 struct Record_decl : Decl
 {
   Record_decl(Symbol const* n, Decl_seq const& f)
-    : Decl(n, nullptr), fields_(f)
+    : Decl(record_decl, n, nullptr), fields_(f), size_(0)
   { }
 
+  static bool classof(Decl const* d) { return d->kind() == record_decl; }
+
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
 
   Decl_seq const& fields() const { return fields_; }
 
+  int size() const { return size_; }
+
   Decl_seq fields_;
+  int      size_;
 };
 
 
-// A member of a record.
+// A member of a record. The offset of the field is
+// the index of its first slot within the record.
 struct Field_decl : Decl
 {
-  using Decl::Decl;
+  Field_decl(Symbol const* n, Type const* t)
+    : Decl(field_decl, n, t), offset_(-1)
+  { }
+
+  static bool classof(Decl const* d) { return d->kind() == field_decl; }
 
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
+
+  int offset() const { return offset_; }
+
+  int offset_;
 };
 
 
 // A module is a sequence of top-level declarations.
+// The frame size of a module is the number of its
+// global variables.
 struct Module_decl : Decl
 {
   Module_decl(Symbol const* n, Decl_seq const& d)
-    : Decl(n, nullptr), decls_(d)
+    : Decl(module_decl, n, nullptr), decls_(d), frame_(0)
   { }
 
+  static bool classof(Decl const* d) { return d->kind() == module_decl; }
+
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
 
   Decl_seq const& declarations() const { return decls_; }
 
+  int frame_size() const { return frame_; }
+
   Decl_seq decls_;
+  int      frame_;
 };
 
 
@@ -186,6 +288,10 @@ defines_object(Decl const* d)
 }
 
 
+int object_size(Type const*);
+int parameter_size(Function_decl const*);
+
+
 // -------------------------------------------------------------------------- //
 //                              Generic visitors
 
@@ -205,13 +311,21 @@ struct Generic_decl_visitor : Decl::Visitor, lingo::Generic_visitor<F, T>
 };
 
 
-// Apply fn to the declaration d.
+// Apply fn to the declaration d. Dispatch is by the
+// kind of the declaration.
 template<typename F, typename T = typename std::result_of<F(Variable_decl const*)>::type>
 inline T
 apply(Decl const* d, F fn)
 {
-  Generic_decl_visitor<F, T> v = fn;
-  return accept(d, v);
+  switch (d->kind()) {
+    case Decl::variable_decl: return fn(static_cast<Variable_decl const*>(d));
+    case Decl::function_decl: return fn(static_cast<Function_decl const*>(d));
+    case Decl::parameter_decl: return fn(static_cast<Parameter_decl const*>(d));
+    case Decl::record_decl: return fn(static_cast<Record_decl const*>(d));
+    case Decl::field_decl: return fn(static_cast<Field_decl const*>(d));
+    case Decl::module_decl: return fn(static_cast<Module_decl const*>(d));
+  }
+  throw std::logic_error("invalid declaration kind");
 }
 
 
@@ -231,13 +345,21 @@ struct Generic_decl_mutator : Decl::Mutator, lingo::Generic_mutator<F, T>
 };
 
 
-// Apply fn to the propositoin p.
+// Apply fn to the declaration d. Dispatch is by the
+// kind of the declaration.
 template<typename F, typename T = typename std::result_of<F(Variable_decl*)>::type>
 inline T
 apply(Decl* d, F fn)
 {
-  Generic_decl_mutator<F, T> v = fn;
-  return accept(d, v);
+  switch (d->kind()) {
+    case Decl::variable_decl: return fn(static_cast<Variable_decl*>(d));
+    case Decl::function_decl: return fn(static_cast<Function_decl*>(d));
+    case Decl::parameter_decl: return fn(static_cast<Parameter_decl*>(d));
+    case Decl::record_decl: return fn(static_cast<Record_decl*>(d));
+    case Decl::field_decl: return fn(static_cast<Field_decl*>(d));
+    case Decl::module_decl: return fn(static_cast<Module_decl*>(d));
+  }
+  throw std::logic_error("invalid declaration kind");
 }
 
 
@@ -9,7 +9,10 @@
 #include "convert.hpp"
 #include "error.hpp"
 
+#include <algorithm>
 #include <iostream>
+#include <limits>
+#include <unordered_set>
 
 
 // -------------------------------------------------------------------------- //
@@ -79,6 +82,476 @@ Scope_stack::function() const
 }
 
 
+// -------------------------------------------------------------------------- //
+// Attribute inference
+
+namespace
+{
+
+// Returns the declaration of the object designated by e,
+// or of the object that contains it. Returns nullptr if
+// e does not designate a named object.
+Decl const*
+object_decl(Expr const* e)
+{
+  if (Id_expr const* id = as<Id_expr>(e))
+    return id->declaration();
+  if (Member_expr const* m = as<Member_expr>(e))
+    return object_decl(m->object());
+  if (Index_expr const* i = as<Index_expr>(e))
+    return object_decl(i->array());
+  return nullptr;
+}
+
+
+// Returns true if the function f can be reached from
+// the function g in the call graph cg. A call through
+// a function object can reach any function.
+bool
+reaches(Call_graph const& cg, Function_decl const* g, Function_decl const* f)
+{
+  std::unordered_set<Function_decl const*> seen;
+  std::vector<Function_decl const*> work {g};
+  while (!work.empty()) {
+    Function_decl const* h = work.back();
+    work.pop_back();
+    if (h == f)
+      return true;
+    if (!seen.insert(h).second)
+      continue;
+    Call_node const& n = cg.at(h);
+    if (n.indirect)
+      return true;
+    work.insert(work.end(), n.callees.begin(), n.callees.end());
+  }
+  return false;
+}
+
+} // namespace
+
+
+// Returns the call graph node of the current function,
+// or nullptr if there is no current function (e.g., in
+// the initializer of a global variable).
+Call_node*
+Elaborator::caller()
+{
+  if (Function_decl* fn = stack.function())
+    return &calls[fn];
+  return nullptr;
+}
+
+
+// Note that the current function, if any, has a runtime
+// check that can fail.
+void
+Elaborator::checked()
+{
+  if (Call_node* n = caller())
+    n->checks = true;
+}
+
+
+// Infer the attributes of the functions in the module m
+// from its call graph. A function is non-recursive when
+// it cannot be reached from the functions that it calls.
+// The other attributes are assumed of every function and
+// removed from those whose bodies, or callees, lack them
+// until nothing changes.
+//
+// Since a function only calls itself and the functions
+// declared before it, a single pass would do, but the
+// inference does not depend on that.
+void
+Elaborator::infer(Module_decl* m)
+{
+  std::vector<Function_decl*> fns;
+  for (Decl* d : m->declarations()) {
+    if (Function_decl* f = as<Function_decl>(d)) {
+      calls[f];
+      fns.push_back(f);
+    }
+  }
+
+  for (Function_decl* f : fns) {
+    Call_node const& n = calls[f];
+    f->norecurse_ = !n.indirect;
+    for (Function_decl const* g : n.callees)
+      f->norecurse_ = f->norecurse_ && !reaches(calls, g, f);
+  }
+
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (Function_decl* f : fns) {
+      Call_node const& n = calls[f];
+      bool pure = !n.reads && !n.writes && !n.indirect;
+      bool readonly = !n.writes && !n.indirect;
+      bool nounwind = !n.checks && !n.indirect;
+      bool willreturn = f->norecurse_ && !n.loops && !n.checks;
+      for (Function_decl const* g : n.callees) {
+        pure = pure && g->pure_;
+        readonly = readonly && g->readonly_;
+        nounwind = nounwind && g->nounwind_;
+        willreturn = willreturn && g->willreturn_;
+      }
+      if (pure != f->pure_ || readonly != f->readonly_ ||
+          nounwind != f->nounwind_ || willreturn != f->willreturn_)
+        changed = true;
+      f->pure_ = pure;
+      f->readonly_ = readonly;
+      f->nounwind_ = nounwind;
+      f->willreturn_ = willreturn;
+    }
+  }
+}
+
+
+// -------------------------------------------------------------------------- //
+// Frame allocation
+
+// Allocate frame slots for the object declared by d,
+// returning the first. Objects declared within a function
+// are allocated in the frame of that function. All others
+// are allocated in the frame of the module.
+int
+Elaborator::allocate(Decl* d)
+{
+  int size = object_size(d->type());
+  if (Function_decl* fn = stack.function()) {
+    int n = slots;
+    slots += size;
+    fn->frame_ = std::max(fn->frame_, slots);
+    return n;
+  }
+  Module_decl* m = stack.module();
+  int n = m->frame_;
+  m->frame_ += size;
+  return n;
+}
+
+
+// -------------------------------------------------------------------------- //
+// Bounds checking
+//
+// An array index is checked against the extent of the
+// array when the element is accessed. In a loop of the
+// form
+//
+//    var i : int = k;
+//    while (i < n) s
+//
+// where k and n are literals and k is not negative, the
+// check of each access a[i] in the body is removed when
+// n does not exceed the extent of a, provided that the
+// body only increases i, and only after the statements
+// containing those accesses. Each such access sees a
+// value of i in the range [0, n).
+
+namespace
+{
+
+// Returns true if e is an integer literal, and stores
+// its value in n.
+bool
+integer_literal(Expr const* e, Integer& n)
+{
+  if (Literal_expr const* lit = as<Literal_expr>(e)) {
+    if (Integer_sym const* sym = as<Integer_sym>(lit->symbol())) {
+      n = sym->value();
+      return true;
+    }
+  }
+  return false;
+}
+
+
+// Returns the local object named by e (possibly after
+// a value conversion), or nullptr if there is none.
+Decl const*
+local_object(Expr const* e)
+{
+  if (Value_conv const* c = as<Value_conv>(e))
+    e = c->source();
+  if (Id_expr const* id = as<Id_expr>(e)) {
+    Decl const* d = id->declaration();
+    if (Variable_decl const* v = as<Variable_decl>(d))
+      return is_local_variable(v) ? v : nullptr;
+    if (is<Parameter_decl>(d))
+      return d;
+  }
+  return nullptr;
+}
+
+
+// If the condition c has the form i < n, i <= n, n > i,
+// or n >= i, where i is a local object and n a literal,
+// returns i and stores the exclusive upper bound of i in
+// the bound. Otherwise, returns nullptr.
+Decl const*
+upper_bound(Expr const* c, Integer& bound)
+{
+  Binary_expr const* e = as<Binary_expr>(c);
+  if (!e)
+    return nullptr;
+  Decl const* d = nullptr;
+  Integer n;
+  if (is<Lt_expr>(e) || is<Le_expr>(e)) {
+    if (integer_literal(e->right(), n))
+      d = local_object(e->left());
+  } else if (is<Gt_expr>(e) || is<Ge_expr>(e)) {
+    if (integer_literal(e->left(), n))
+      d = local_object(e->right());
+  }
+  if (!d)
+    return nullptr;
+  bound = is<Le_expr>(e) || is<Ge_expr>(e) ? n + 1 : n;
+  return d;
+}
+
+
+// Returns true if the statement s sets the object d to a
+// literal that is not negative.
+bool
+sets_nonnegative(Stmt const* s, Decl const* d)
+{
+  Integer n;
+  if (Declaration_stmt const* s1 = as<Declaration_stmt>(s)) {
+    if (s1->declaration() != d)
+      return false;
+    Expr const* init = cast<Variable_decl>(d)->init();
+    if (is<Default_init>(init))
+      return true;
+    if (Copy_init const* c = as<Copy_init>(init))
+      return integer_literal(c->value(), n) && n.sign() >= 0;
+  }
+  if (Assign_stmt const* s1 = as<Assign_stmt>(s)) {
+    if (local_object(s1->object()) != d)
+      return false;
+    return integer_literal(s1->value(), n) && n.sign() >= 0;
+  }
+  return false;
+}
+
+
+// The index of a loop, and its exclusive upper bound
+// within the body of the loop.
+struct Loop_index
+{
+  bool assigns(Stmt const*);
+  void mark(Stmt*);
+  void mark(Expr*);
+
+  Decl const* var;
+  Integer     bound;
+  bool        increasing; // Every assignment increases var
+};
+
+
+// Returns true if the statement s assigns to the index.
+// Each assignment shall have the form i = i + k, where k
+// is a literal that is not negative and i + k cannot
+// overflow. Otherwise, the index is not increasing.
+bool
+Loop_index::assigns(Stmt const* s)
+{
+  struct Fn
+  {
+    Loop_index& idx;
+
+    bool operator()(Empty_stmt const*) { return false; }
+
+    bool operator()(Block_stmt const* s)
+    {
+      bool r = false;
+      for (Stmt const* s1 : s->statements())
+        r |= idx.assigns(s1);
+      return r;
+    }
+
+    bool operator()(Assign_stmt const* s)
+    {
+      if (local_object(s->object()) != idx.var)
+        return false;
+      Add_expr const* e = as<Add_expr>(s->value());
+      Integer k;
+      Integer max = std::numeric_limits<Integer::Word>::max();
+      if (!e || local_object(e->left()) != idx.var
+             || !integer_literal(e->right(), k)
+             || k.sign() < 0
+             || max < idx.bound + k)
+        idx.increasing = false;
+      return true;
+    }
+
+    bool operator()(Return_stmt const*) { return false; }
+    bool operator()(If_then_stmt const* s) { return idx.assigns(s->body()); }
+
+    bool operator()(If_else_stmt const* s)
+    {
+      bool r = idx.assigns(s->true_branch());
+      return idx.assigns(s->false_branch()) || r;
+    }
+
+    bool operator()(While_stmt const* s) { return idx.assigns(s->body()); }
+    bool operator()(Break_stmt const*) { return false; }
+    bool operator()(Continue_stmt const*) { return false; }
+    bool operator()(Expression_stmt const*) { return false; }
+    bool operator()(Declaration_stmt const*) { return false; }
+  };
+
+  return apply(s, Fn{*this});
+}
+
+
+// Remove the bounds checks of accesses a[i] in s.
+void
+Loop_index::mark(Stmt* s)
+{
+  struct Fn
+  {
+    Loop_index& idx;
+
+    void operator()(Empty_stmt*) { }
+
+    void operator()(Block_stmt* s)
+    {
+      for (Stmt* s1 : s->statements())
+        idx.mark(s1);
+    }
+
+    void operator()(Assign_stmt* s)
+    {
+      idx.mark(s->object());
+      idx.mark(s->value());
+    }
+
+    void operator()(Return_stmt* s) { idx.mark(s->value()); }
+
+    void operator()(If_then_stmt* s)
+    {
+      idx.mark(s->condition());
+      idx.mark(s->body());
+    }
+
+    void operator()(If_else_stmt* s)
+    {
+      idx.mark(s->condition());
+      idx.mark(s->true_branch());
+      idx.mark(s->false_branch());
+    }
+
+    void operator()(While_stmt* s)
+    {
+      idx.mark(s->condition());
+      idx.mark(s->body());
+    }
+
+    void operator()(Break_stmt*) { }
+    void operator()(Continue_stmt*) { }
+    void operator()(Expression_stmt* s) { idx.mark(s->expression()); }
+
+    void operator()(Declaration_stmt* s)
+    {
+      if (Variable_decl* v = as<Variable_decl>(s->declaration()))
+        idx.mark(v->init());
+    }
+  };
+
+  apply(s, Fn{*this});
+}
+
+
+// Remove the bounds checks of accesses a[i] in e.
+void
+Loop_index::mark(Expr* e)
+{
+  struct Fn
+  {
+    Loop_index& idx;
+
+    void operator()(Literal_expr*) { }
+    void operator()(Id_expr*) { }
+    void operator()(Unary_expr* e) { idx.mark(e->operand()); }
+
+    void operator()(Binary_expr* e)
+    {
+      idx.mark(e->left());
+      idx.mark(e->right());
+    }
+
+    void operator()(Call_expr* e)
+    {
+      idx.mark(e->target());
+      for (Expr* a : e->arguments())
+        idx.mark(a);
+    }
+
+    void operator()(Member_expr* e) { idx.mark(e->object()); }
+
+    void operator()(Index_expr* e)
+    {
+      idx.mark(e->array());
+      idx.mark(e->index());
+      Array_type const* t = cast<Array_type>(e->array()->type()->nonref());
+      if (local_object(e->index()) == idx.var
+          && !(Integer(t->extent()) < idx.bound))
+        e->checked_ = false;
+    }
+
+    void operator()(Value_conv* e) { idx.mark(e->source()); }
+    void operator()(Default_init*) { }
+    void operator()(Copy_init* e) { idx.mark(e->first); }
+  };
+
+  apply(e, Fn{*this});
+}
+
+
+// Remove the bounds checks that are made redundant by
+// the condition of the loop s. The statement init
+// precedes the loop. When the condition is a conjunction,
+// the bound is given by its left operand, and also
+// applies to its right operand.
+void
+remove_bounds_checks(Stmt const* init, While_stmt* s)
+{
+  Expr* c = s->condition();
+  Expr* rest = nullptr;
+  if (And_expr* e = as<And_expr>(c)) {
+    c = e->left();
+    rest = e->right();
+  }
+
+  Loop_index idx;
+  idx.var = upper_bound(c, idx.bound);
+  idx.increasing = true;
+  if (!idx.var || !sets_nonnegative(init, idx.var))
+    return;
+
+  // Find the first statement that assigns to the index.
+  Stmt_seq body;
+  if (Block_stmt* b = as<Block_stmt>(s->body()))
+    body = b->statements();
+  else
+    body.push_back(s->body());
+  std::size_t first = body.size();
+  for (std::size_t i = 0; i < body.size(); ++i) {
+    if (idx.assigns(body[i]) && first == body.size())
+      first = i;
+  }
+  if (!idx.increasing)
+    return;
+
+  if (rest)
+    idx.mark(rest);
+  for (std::size_t i = 0; i < first; ++i)
+    idx.mark(body[i]);
+}
+
+} // namespace
+
+
 // -------------------------------------------------------------------------- //
 // Elaboration of types
 
@@ -96,6 +569,7 @@ Elaborator::elaborate(Type const* t)
     Type const* operator()(Function_type const* t) { return elab.elaborate(t); }
     Type const* operator()(Reference_type const* t) { return elab.elaborate(t); }
     Type const* operator()(Record_type const* t) { return elab.elaborate(t); }
+    Type const* operator()(Array_type const* t) { return elab.elaborate(t); }
   };
   return apply(t, Fn{*this});
 }
@@ -167,6 +641,24 @@ Elaborator::elaborate(Record_type const* t)
 }
 
 
+// The element type shall be a complete object type, and
+// the array shall not occupy more slots than an int can
+// count.
+Type const*
+Elaborator::elaborate(Array_type const* t)
+{
+  Type const* t1 = elaborate(t->type());
+  if (is<Reference_type>(t1))
+    throw Type_error({}, "array of references");
+  std::int64_t n = object_size(t1);
+  if (n == 0)
+    throw Type_error({}, "array element has incomplete type");
+  if (n * t->extent() > std::numeric_limits<int>::max())
+    throw Type_error({}, "array is too large");
+  return get_array_type(t1, t->extent());
+}
+
+
 // -------------------------------------------------------------------------- //
 // Elaboration of expressions
 
@@ -199,6 +691,8 @@ Elaborator::elaborate(Expr* e)
     Expr* operator()(Or_expr* e) const { return elab.elaborate(e); }
     Expr* operator()(Not_expr* e) const { return elab.elaborate(e); }
     Expr* operator()(Call_expr* e) const { return elab.elaborate(e); }
+    Expr* operator()(Member_expr* e) const { return elab.elaborate(e); }
+    Expr* operator()(Index_expr* e) const { return elab.elaborate(e); }
     Expr* operator()(Value_conv* e) const { return elab.elaborate(e); }
     Expr* operator()(Default_init* e) const { return elab.elaborate(e); }
     Expr* operator()(Copy_init* e) const { return elab.elaborate(e); }
@@ -245,6 +739,15 @@ Elaborator::elaborate(Id_expr* e)
   Decl* d = b->second;
   e->declaration(d);
 
+  // A function that refers to a global variable
+  // is not pure.
+  if (Variable_decl* v = as<Variable_decl>(d)) {
+    if (is_global_variable(v)) {
+      if (Call_node* n = caller())
+        n->reads = true;
+    }
+  }
+
   // If the referenced declaration is a variable of
   // type T, then the type is T&. Otherwise, it is just T.
   Type const* t = d->type();
@@ -338,6 +841,7 @@ check_unary_arithmetic_expr(Elaborator& elab, Unary_expr* e)
 Expr*
 Elaborator::elaborate(Add_expr* e)
 {
+  checked();
   return check_binary_arithmetic_expr(*this, e);
 }
 
@@ -345,6 +849,7 @@ Elaborator::elaborate(Add_expr* e)
 Expr*
 Elaborator::elaborate(Sub_expr* e)
 {
+  checked();
   return check_binary_arithmetic_expr(*this, e);
 }
 
@@ -352,6 +857,7 @@ Elaborator::elaborate(Sub_expr* e)
 Expr*
 Elaborator::elaborate(Mul_expr* e)
 {
+  checked();
   return check_binary_arithmetic_expr(*this, e);
 }
 
@@ -359,6 +865,7 @@ Elaborator::elaborate(Mul_expr* e)
 Expr*
 Elaborator::elaborate(Div_expr* e)
 {
+  checked();
   return check_binary_arithmetic_expr(*this, e);
 }
 
@@ -366,6 +873,7 @@ Elaborator::elaborate(Div_expr* e)
 Expr*
 Elaborator::elaborate(Rem_expr* e)
 {
+  checked();
   return check_binary_arithmetic_expr(*this, e);
 }
 
@@ -374,6 +882,7 @@ Elaborator::elaborate(Rem_expr* e)
 Expr*
 Elaborator::elaborate(Neg_expr* e)
 {
+  checked();
   return check_unary_arithmetic_expr(*this, e);
 }
 
@@ -569,6 +1078,19 @@ Elaborator::elaborate(Call_expr* e)
     }
   }
 
+  // Add the call to the call graph. A call that does
+  // not name a function is through a function object.
+  if (Call_node* n = caller()) {
+    Id_expr const* id = as<Id_expr>(f);
+    if (!id || !is<Function_decl>(id->declaration())) {
+      n->indirect = true;
+    } else {
+      Function_decl const* g = cast<Function_decl>(id->declaration());
+      if (std::find(n->callees.begin(), n->callees.end(), g) == n->callees.end())
+        n->callees.push_back(g);
+    }
+  }
+
   // The type of the expression is that of the
   // function return type.
   e->type(t->return_type());
@@ -577,6 +1099,75 @@ Elaborator::elaborate(Call_expr* e)
 }
 
 
+// The object operand shall have record type, and the
+// name shall be one of its fields. When the object
+// operand is a reference, the type of the expression
+// is a reference to the type of the field. Otherwise,
+// it is the type of the field.
+Expr*
+Elaborator::elaborate(Member_expr* e)
+{
+  Expr* obj = elaborate(e->first);
+  e->first = obj;
+  Record_type const* t = as<Record_type>(obj->type()->nonref());
+  if (!t)
+    throw Type_error({}, "member access to non-record");
+
+  Record_decl const* r = t->declaration();
+  for (Decl* d : r->fields()) {
+    if (d->name() == e->name()) {
+      e->field_ = cast<Field_decl>(d);
+      break;
+    }
+  }
+  if (!e->field_) {
+    std::stringstream ss;
+    ss << "no field named '" << *e->name() << "' in '"
+       << *r->name() << '\'';
+    throw Lookup_error(locs.get(e), ss.str());
+  }
+
+  Type const* t1 = e->field_->type();
+  if (is<Reference_type>(obj->type()))
+    t1 = t1->ref();
+  e->type(t1);
+  return e;
+}
+
+
+// The array operand shall have array type, and the
+// index shall be an integer. When the array operand is
+// a reference, the type of the expression is a reference
+// to the element type. Otherwise, it is the element type.
+Expr*
+Elaborator::elaborate(Index_expr* e)
+{
+  Expr* a = elaborate(e->first);
+  e->first = a;
+  Array_type const* t = as<Array_type>(a->type()->nonref());
+  if (!t)
+    throw Type_error({}, "subscript of non-array");
+  if (!require_converted(*this, e->second, get_integer_type()))
+    throw Type_error({}, "array index does not have type 'int'");
+
+  // A literal index is checked now.
+  Integer n;
+  if (integer_literal(e->second, n)) {
+    if (n.sign() < 0 || !(n < Integer(t->extent())))
+      throw Type_error({}, "array index out of bounds");
+    e->checked_ = false;
+  } else {
+    checked();
+  }
+
+  Type const* t1 = t->type();
+  if (is<Reference_type>(a->type()))
+    t1 = t1->ref();
+  e->type(t1);
+  return e;
+}
+
+
 // Conversions are created after their source expressions
 // have been elaborated. No action is required. In fact,
 // we probably never actually call this function.
@@ -649,8 +1240,9 @@ Elaborator::elaborate(Variable_decl* d)
 {
   d->type_ = elaborate(d->type_);
 
-  // Declare the variable.
+  // Declare the variable and allocate its storage.
   stack.declare(d);
+  d->slot_ = allocate(d);
 
   // Elaborate the initializer. Note that the initializers
   // type must be the same as that of the declaration.
@@ -683,9 +1275,12 @@ Elaborator::elaborate(Function_decl* d)
 
   // Enter the function scope and declare all
   // of the parameters (by way of elaboration).
+  // Parameters are allocated the first slots
+  // of the function's frame.
   //
   // TODO: Handle failed parameter elaborations.
   Scope_sentinel scope(*this, d);
+  slots = 0;
   for (Decl* p : d->parameters())
     elaborate(p);
 
@@ -697,30 +1292,45 @@ Elaborator::elaborate(Function_decl* d)
 }
 
 
-// Elaborate a parameter declaration. This simply declares
-// the parameter in the current scope.
+// Elaborate a parameter declaration. This declares
+// the parameter in the current scope and allocates
+// its slot in the function's frame.
 void
 Elaborator::elaborate(Parameter_decl* d)
 {
   d->type_ = elaborate(d->type_);
   stack.declare(d);
+  d->slot_ = allocate(d);
 }
 
 
+// Elaborate the fields of the record and compute its
+// layout. Each field is placed after the previous one.
+// An empty record still occupies a slot.
 void
 Elaborator::elaborate(Record_decl* d)
 {
   stack.declare(d);
   Scope_sentinel scope(*this, d);
-  for (Decl* d1 : d->fields())
+  int size = 0;
+  for (Decl* d1 : d->fields()) {
     elaborate(d1);
+    Field_decl* f = cast<Field_decl>(d1);
+    f->offset_ = size;
+    size += object_size(f->type());
+  }
+  d->size_ = std::max(size, 1);
 }
 
 
+// A field shall not have the type of a record whose
+// layout is not yet known (e.g., its own record).
 void
 Elaborator::elaborate(Field_decl* d)
 {
   d->type_ = elaborate(d->type_);
+  if (object_size(d->type_) == 0)
+    throw Type_error({}, "field has incomplete type");
   stack.declare(d);
 }
 
@@ -733,6 +1343,7 @@ Elaborator::elaborate(Module_decl* m)
   Scope_sentinel scope(*this, m);
   for (Decl* d : m->declarations())
     elaborate(d);
+  infer(m);
 }
 
 
@@ -771,12 +1382,27 @@ Elaborator::elaborate(Empty_stmt*)
 }
 
 
+// Variables declared in the block go out of scope
+// at its end, so their slots can be reused by later
+// declarations in the enclosing function.
+//
+// The bounds checks of a loop are removed after the
+// block is elaborated, since that depends on the
+// statement preceding the loop.
 void
 Elaborator::elaborate(Block_stmt* s)
 {
   Scope_sentinel scope = *this;
+  int mark = slots;
   for (Stmt* s1 : s->statements())
     elaborate(s1);
+  slots = mark;
+
+  Stmt_seq const& ss = s->statements();
+  for (std::size_t i = 1; i < ss.size(); ++i) {
+    if (While_stmt* w = as<While_stmt>(ss[i]))
+      remove_bounds_checks(ss[i - 1], w);
+  }
 }
 
 
@@ -804,6 +1430,14 @@ Elaborator::elaborate(Assign_stmt* s)
   Type const* t2 = rhs->type();
   if (t1 != t2)
     throw Type_error({}, "assignment to an object of a different type");
+
+  // Note assignments to global variables.
+  if (Variable_decl const* v = as<Variable_decl>(object_decl(lhs))) {
+    if (is_global_variable(v)) {
+      if (Call_node* n = caller())
+        n->writes = true;
+    }
+  }
 }
 
 
@@ -821,6 +1455,10 @@ Elaborator::elaborate(Return_stmt* s)
   Expr* c = require_converted(*this, s->first, t);
   if (!c)
     throw std::runtime_error("return type mismatch");
+
+  // A returned call is a tail call.
+  if (Call_expr* call = as<Call_expr>(c))
+    call->tail_ = true;
 }
 
 
@@ -853,6 +1491,8 @@ Elaborator::elaborate(While_stmt* s)
   Expr* c = require_converted(*this, s->first, get_boolean_type());
   if (!c)
     throw Type_error({}, "loop condition does not have type 'bool'");
+  if (Call_node* n = caller())
+    n->loops = true;
   elaborate(s->body());
 }
 
@@ -60,6 +60,24 @@ struct Scope_stack : Stack<Scope>
 };
 
 
+// A node of the call graph. It records the functions
+// that a function calls by name, and the effects of its
+// own body. The attributes of functions are inferred from
+// the call graph once the module has been elaborated.
+struct Call_node
+{
+  std::vector<Function_decl const*> callees;
+  bool reads    = false; // Reads a global variable
+  bool writes   = false; // Writes a global variable
+  bool indirect = false; // Calls a function object
+  bool loops    = false; // Contains a loop
+  bool checks   = false; // Has a runtime check
+};
+
+
+using Call_graph = std::unordered_map<Function_decl const*, Call_node>;
+
+
 // The elaborator is responsible for the annotation of
 // an AST with type and other information.
 class Elaborator
@@ -75,6 +93,7 @@ public:
   Type const* elaborate(Function_type const*);
   Type const* elaborate(Reference_type const*);
   Type const* elaborate(Record_type const*);
+  Type const* elaborate(Array_type const*);
 
   Expr* elaborate(Expr*);
   Expr* elaborate(Literal_expr*);
@@ -96,6 +115,8 @@ public:
   Expr* elaborate(Or_expr* e);
   Expr* elaborate(Not_expr* e);
   Expr* elaborate(Call_expr* e);
+  Expr* elaborate(Member_expr* e);
+  Expr* elaborate(Index_expr* e);
   Expr* elaborate(Value_conv* e);
   Expr* elaborate(Default_init* e);
   Expr* elaborate(Copy_init* e);
@@ -127,8 +148,15 @@ public:
   Function_decl* main = nullptr;
 
 private:
+  int        allocate(Decl*);
+  Call_node* caller();
+  void       checked();
+  void       infer(Module_decl*);
+
   Location_map locs;
   Scope_stack  stack;
+  Call_graph   calls;
+  int          slots = 0; // Next free slot in the current frame
 };
 
 
@@ -2,13 +2,48 @@
 // All rights reserved
 
 #include "evaluator.hpp"
+#include "type.hpp"
 #include "expr.hpp"
 #include "decl.hpp"
 #include "stmt.hpp"
 #include "error.hpp"
 
+#include <exception>
+#include <functional>
 #include <iostream>
 
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+
+namespace
+{
+
+// Store the value v in the object of type t at p. The
+// value of an aggregate is a reference to its block,
+// which is copied.
+inline void
+store(Value* p, Type const* t, Value v)
+{
+  if (is_aggregate(t))
+    std::copy_n(v.as_reference(), object_size(t), p);
+  else
+    *p = v;
+}
+
+} // namespace
+
+
+// Allocate the frame for a call to f.
+Evaluator::Frame_sentinel::Frame_sentinel(Evaluator& e, Function_decl const* f)
+  : eval(e)
+  , prev(e.frame)
+  , prev_fn(e.fn)
+  , frame(e.stack.push(f->frame_size()))
+  , fn(f)
+{ }
+
 
 Value
 Evaluator::eval(Expr const* e)
@@ -36,6 +71,8 @@ Evaluator::eval(Expr const* e)
     Value operator()(Or_expr const* e) { return ev.eval(e); }
     Value operator()(Not_expr const* e) { return ev.eval(e); }
     Value operator()(Call_expr const* e) { return ev.eval(e); }
+    Value operator()(Member_expr const* e) { return ev.eval(e); }
+    Value operator()(Index_expr const* e) { return ev.eval(e); }
     Value operator()(Value_conv const* e) { return ev.eval(e); }
     Value operator()(Default_init const* e) { return ev.eval(e); }
     Value operator()(Copy_init const* e) { return ev.eval(e); }
@@ -51,46 +88,54 @@ Evaluator::eval(Literal_expr const* e)
   Symbol const* s = e->symbol();
   if (Boolean_sym const* b = as<Boolean_sym>(s))
     return b->value();
-  if (Integer_sym const* z = as<Integer_sym>(s))
-    return z->value();
+  if (Integer_sym const* z = as<Integer_sym>(s)) {
+    Integer const& n = z->value();
+    return n.is_word() ? Value(n.word()) : make_integer(arith, n);
+  }
   throw std::runtime_error("ill-formed literal");
 }
 
 
+// An identifier that names an object evaluates to a
+// reference to that object. An identifier that names
+// a function evaluates to the function itself.
 Value
 Evaluator::eval(Id_expr const* e)
 {
-  return &stack.lookup(e->symbol())->second;
+  Decl const* d = e->declaration();
+  if (Function_decl const* f = as<Function_decl>(d))
+    return f;
+  else
+    return &storage(d);
 }
 
 
-// TODO: Detect overflow.
+// The results of arithmetic operations depend on the
+// arithmetic mode of the evaluator.
 Value
 Evaluator::eval(Add_expr const* e)
 {
   Value v1 = eval(e->left());
   Value v2 = eval(e->right());
-  return v1.get_integer() + v2.get_integer();
+  return integer_add(arith, v1, v2);
 }
 
 
-// TODO: Detect overflow.
 Value
 Evaluator::eval(Sub_expr const* e)
 {
   Value v1 = eval(e->left());
   Value v2 = eval(e->right());
-  return v1.get_integer() - v2.get_integer();
+  return integer_sub(arith, v1, v2);
 }
 
 
-// TODO: Detect overflow.
 Value
 Evaluator::eval(Mul_expr const* e)
 {
   Value v1 = eval(e->left());
   Value v2 = eval(e->right());
-  return v1.get_integer() * v2.get_integer();
+  return integer_mul(arith, v1, v2);
 }
 
 
@@ -99,9 +144,7 @@ Evaluator::eval(Div_expr const* e)
 {
   Value v1 = eval(e->left());
   Value v2 = eval(e->right());
-  if (v2.get_integer() == 0)
-    throw std::runtime_error("division by 0");
-  return v1.get_integer() / v2.get_integer();
+  return integer_div(arith, v1, v2);
 }
 
 
@@ -110,9 +153,7 @@ Evaluator::eval(Rem_expr const* e)
 {
   Value v1 = eval(e->left());
   Value v2 = eval(e->right());
-  if (v2.get_integer() == 0)
-    throw std::runtime_error("division by 0");
-  return v1.get_integer() / v2.get_integer();
+  return integer_rem(arith, v1, v2);
 }
 
 
@@ -120,7 +161,7 @@ Value
 Evaluator::eval(Neg_expr const* e)
 {
   Value v = eval(e->operand());
-  return -v.get_integer();
+  return integer_neg(arith, v);
 }
 
 
@@ -131,67 +172,33 @@ Evaluator::eval(Pos_expr const* e)
 }
 
 
-// Compare two integer or function values.
-template<typename F>
-bool
-compare_equal(Value const& v1, Value const& v2, F fn)
-{
-  // See through references.
-  Value const& a = v1.is_reference() ? *v1.get_reference() : v1;
-  Value const& b = v2.is_reference() ? *v2.get_reference() : v2;
-
-  // Perform comparison.
-  if (a.kind() == b.kind()) {
-    if (a.is_integer())
-      return fn(a.get_integer(), b.get_integer());
-    if (a.is_function())
-      return fn(a.get_function(), b.get_function());
-  }
-  throw Evaluation_error({}, "invalid operands");
-}
-
-
+// Note that the elaborator guarantees that the operands
+// have the same type.
 Value
 Evaluator::eval(Eq_expr const* e)
 {
   Value v1 = eval(e->left());
   Value v2 = eval(e->right());
-  return compare_equal(v1, v2, std::equal_to<>());
+  return equal(v1, v2);
 }
 
 
-// Compare two integer or function values.
 Value
 Evaluator::eval(Ne_expr const* e)
 {
   Value v1 = eval(e->left());
   Value v2 = eval(e->right());
-  return compare_equal(v1, v2, std::not_equal_to<>());
+  return !equal(v1, v2);
 }
 
 
-// Compare two integer or function values.
-template<typename F>
-bool
-compare_less(Value const& v1, Value const& v2, F fn)
-{
-  Value const& a = v1.is_reference() ? *v1.get_reference() : v1;
-  Value const& b = v2.is_reference() ? *v2.get_reference() : v2;
-
-  if (a.kind() == b.kind()) {
-    if (a.is_integer())
-      return fn(a.get_integer(), b.get_integer());
-  }
-  throw Evaluation_error({}, "invalid operands");
-}
-
 // Order two integer values.
 Value
 Evaluator::eval(Lt_expr const* e)
 {
   Value v1 = eval(e->left());
   Value v2 = eval(e->right());
-  return compare_less(v1, v2, std::less<>());
+  return integer_less(v1, v2);
 }
 
 
@@ -200,7 +207,7 @@ Evaluator::eval(Gt_expr const* e)
 {
   Value v1 = eval(e->left());
   Value v2 = eval(e->right());
-  return compare_less(v1, v2, std::greater<>());
+  return integer_less(v2, v1);
 }
 
 
@@ -209,7 +216,7 @@ Evaluator::eval(Le_expr const* e)
 {
   Value v1 = eval(e->left());
   Value v2 = eval(e->right());
-  return compare_less(v1, v2, std::less_equal<>());
+  return !integer_less(v2, v1);
 }
 
 
@@ -218,7 +225,7 @@ Evaluator::eval(Ge_expr const* e)
 {
   Value v1 = eval(e->left());
   Value v2 = eval(e->right());
-  return compare_less(v1, v2, std::greater_equal<>());
+  return !integer_less(v1, v2);
 }
 
 
@@ -226,7 +233,7 @@ Value
 Evaluator::eval(And_expr const* e)
 {
   Value v = eval(e->left());
-  if (!v.get_integer())
+  if (!v.as_integer())
     return v;
   else
     return eval(e->right());
@@ -237,7 +244,7 @@ Value
 Evaluator::eval(Or_expr const* e)
 {
   Value v = eval(e->left());
-  if (v.get_integer())
+  if (v.as_integer())
     return v;
   else
     return eval(e->right());
@@ -248,7 +255,7 @@ Value
 Evaluator::eval(Not_expr const* e)
 {
   Value v = eval(e->operand());
-  return !v.get_integer();
+  return !v.as_integer();
 }
 
 
@@ -257,62 +264,253 @@ Evaluator::eval(Call_expr const* e)
 {
   // Evaluate the function expression.
   Value v = eval(e->target());
-  Function_decl const* f = v.get_function();
+  Function_decl const* f = v.as_function();
+  step();
 
-  // Evaluate each argument in turn.
-  Value_seq args;
-  args.reserve(e->arguments().size());
-  for (Expr const* a : e->arguments())
-    args.push_back(eval(a));
+  // Calls to compiled functions execute natively.
+  if (jit) {
+    if (Native_fn code = jit->call(f))
+      return call(f, code, e, stack.depth());
+  }
 
-  // Build the new call frame by pushing bindings
-  // from each parameter to the corresponding argument.
+  // Build the new call frame by evaluating each
+  // argument into the slot of its parameter. Note
+  // that arguments are evaluated in the caller's
+  // frame.
   //
   // FIXME: Since everything type-checked, these *must*
   // happen to magically line up. However, it would be
   // a good idea to verify.
-  Store_sentinel frame(*this);
+  Frame_sentinel frame(*this, f);
+  Expr_seq const& args = e->arguments();
   for (std::size_t i = 0; i < args.size(); ++i) {
-    Decl* p = f->parameters()[i];
-    Value& v = args[i];
-    stack.top().bind(p->name(), v);
+    Parameter_decl const* p = cast<Parameter_decl>(f->parameters()[i]);
+    store(frame.frame + p->slot(), p->type(), eval(args[i]));
   }
 
+  // A call to a pure function may be answered by the
+  // memo table. The key is the block of parameter slots.
+  // Note that the key is copied before the call, since
+  // parameters can be modified. An aggregate result
+  // refers to the callee's frame, so it is never cached.
+  Value_seq key;
+  bool memoize = memo && f->pure() && !is_aggregate(f->return_type());
+  if (memoize) {
+    std::size_t n = parameter_size(f);
+    if (Value const* v = memo->find(f, frame.frame, n))
+      return *v;
+    key.assign(frame.frame, frame.frame + n);
+  }
+  frame.activate();
+
   // Evaluate the function definition.
   //
   // TODO: Check result in case we've thrown
   // an exception (for example).
   Value result;
-  Control ctl = eval(f->body(), result);
-  if (ctl != return_ctl)
-    throw std::runtime_error("function evaluation failed");
+  {
+    Profile_sentinel p(prof, f);
+    Control ctl = eval(f->body(), result);
+    if (ctl != return_ctl)
+      throw std::runtime_error("function evaluation failed");
+  }
+  result = resume(result);
 
+  if (memoize)
+    memo->insert(f, std::move(key), result);
   return result;
 }
 
 
+// Evaluate a tail call. The arguments are evaluated into
+// temporary storage above the current frame, which is
+// then re-used for the callee: the arguments are moved
+// into the parameter slots, the frame is resized, and the
+// callee becomes the current function. The body of the
+// callee is evaluated by the caller of the function that
+// made the tail call (see resume()), so the native stack
+// does not grow.
+//
+// Calls to compiled functions are not replaced, but their
+// native code may nest as deep as if they were.
+Control
+Evaluator::tail_call(Call_expr const* e, Value& r)
+{
+  Function_decl const* f = eval(e->target()).as_function();
+  if (jit) {
+    if (Native_fn code = jit->call(f)) {
+      r = call(f, code, e, stack.depth() - 1);
+      return return_ctl;
+    }
+  }
+
+  // Parameters occupy the first slots of the frame, so
+  // the arguments can be copied into place. Note that
+  // the copy is safe even if the temporaries overlap
+  // the parameter slots.
+  Expr_seq const& args = e->arguments();
+  std::size_t n = parameter_size(f);
+  Value* tmp = stack.allocate(n);
+  for (std::size_t i = 0; i < args.size(); ++i) {
+    Parameter_decl const* p = cast<Parameter_decl>(f->parameters()[i]);
+    store(tmp + p->slot(), p->type(), eval(args[i]));
+  }
+  std::copy(tmp, tmp + n, frame);
+  stack.resize(frame, f->frame_size());
+
+  fn = f;
+  tail = f;
+  ++tails;
+  return return_ctl;
+}
+
+
+// Complete the pending tail calls made by the body of
+// the current function, returning the final result. The
+// result r is returned when there are none. Each tail
+// call is profiled as a separate call.
+Value
+Evaluator::resume(Value r)
+{
+  while (Function_decl const* f = tail) {
+    tail = nullptr;
+    step();
+    Profile_sentinel p(prof, f);
+    Control ctl = eval(f->body(), r);
+    if (ctl != return_ctl)
+      throw std::runtime_error("function evaluation failed");
+  }
+  return r;
+}
+
+
+// Call the native code of a compiled function. Arguments
+// are evaluated in the caller's frame. Note that compiled
+// functions only accept and return integers and booleans.
+// The native code of f is profiled as a call to f, but
+// its statements are not. The call is made at depth d,
+// and recursive calls within native code may nest up to
+// the depth limit.
+//
+// When arithmetic is exact, native code cannot accept
+// integers that do not fit in a word, and it fails when
+// a result does not. In either case, f is interpreted
+// instead. Native code has no side effects, so f can be
+// called again after a failure.
+Value
+Evaluator::call(Function_decl const* f, Native_fn code, Call_expr const* e,
+                std::size_t d)
+{
+  Expr_seq const& args = e->arguments();
+  Value vs[Jit::max_args];
+  std::int64_t in[Jit::max_args];
+  bool words = true;
+  for (std::size_t i = 0; i < args.size(); ++i) {
+    vs[i] = eval(args[i]);
+    if (vs[i].is_word())
+      in[i] = vs[i].as_integer();
+    else
+      words = false;
+  }
+  if (words) {
+    std::int64_t out;
+    try {
+      Profile_sentinel p(prof, f);
+      code(in, &out, stack.depth_limit() - d);
+      return Integer_value(out);
+    } catch (std::runtime_error&) {
+      if (arith != exact_arithmetic)
+        throw;
+    }
+  }
+  return invoke(f, vs, args.size());
+}
+
+
+// The field is at a fixed offset in the block of the
+// record object, so the result is a reference to that
+// slot. A scalar field of a record value is loaded.
+Value
+Evaluator::eval(Member_expr const* e)
+{
+  Value* p = eval(e->object()).as_reference() + e->field()->offset();
+  if (is<Reference_type>(e->type()) || is_aggregate(e->type()))
+    return p;
+  return *p;
+}
+
+
+// The elements of an array are stored contiguously, so
+// the result is a reference to the slot at the index
+// scaled by the size of the element. A scalar element of
+// an array value is loaded.
+Value
+Evaluator::eval(Index_expr const* e)
+{
+  Array_type const* t = cast<Array_type>(e->array()->type()->nonref());
+  Value* p = eval(e->array()).as_reference();
+  Value i = eval(e->index());
+  if (e->checked()) {
+    if (!i.is_small() || std::uint64_t(i.as_integer()) >= std::uint64_t(t->extent()))
+      throw std::runtime_error("array index out of bounds");
+  }
+  p += i.as_integer() * object_size(t->type());
+  if (is<Reference_type>(e->type()) || is_aggregate(e->type()))
+    return p;
+  return *p;
+}
+
+
 // Apply an lvalue-to-rvalue conversion by dereferencing
 // the reference value. Note that the source must evaluate
 // to a reference.
+//
+// The value of an aggregate is a reference to its
+// block. It is copied by the initialization or assignment
+// that consumes it. An aggregate returned by a call refers
+// to the released frame of the callee, which is intact
+// until the next call.
 Value
 Evaluator::eval(Value_conv const* e)
 {
   Value v = eval(e->source());
-  return *v.get_reference();
+  if (is_aggregate(e->type()))
+    return v;
+  return *v.as_reference();
 }
 
 
+// Default initialization of a scalar object produces
+// the value 0 (or false). Default initialization of an
+// aggregate sets each slot of its block to 0, and
+// produces a reference to the block.
 Value
 Evaluator::eval(Default_init const* e)
 {
+  if (is<Integer_type>(e->type()) || is<Boolean_type>(e->type()))
+    return 0;
+  if (is_aggregate(e->type())) {
+    Value* p = &storage(e->declaration());
+    std::fill_n(p, object_size(e->type()), Value(0));
+    return p;
+  }
   throw std::runtime_error("not implemented");
 }
 
 
+// Copy initialization of a scalar object produces
+// the value of the initializer. Copy initialization of
+// an aggregate copies the block of the initializer into
+// the block of the object, and produces a reference to it.
 Value
 Evaluator::eval(Copy_init const* e)
 {
-  throw std::runtime_error("not implemented");
+  if (is_aggregate(e->type())) {
+    Value* p = &storage(e->declaration());
+    store(p, e->type(), eval(e->value()));
+    return p;
+  }
+  return eval(e->value());
 }
 
 
@@ -338,19 +536,24 @@ Evaluator::eval(Decl const* d)
 }
 
 
+// Initialize the variable's storage. Aggregates are
+// initialized in place.
 void
 Evaluator::eval(Variable_decl const* d)
 {
-  Value v = eval(d->init());
-  stack.top().bind(d->name(), v);
+  if (is_aggregate(d->type()))
+    eval(d->init());
+  else
+    storage(d) = eval(d->init());
 }
 
 
-// Bind the symbol to a function value.
+// Functions require no storage; identifiers that
+// name functions evaluate directly to them.
 void
 Evaluator::eval(Function_decl const* d)
 {
-  stack.top().bind(d->name(), d);
+  return;
 }
 
 
@@ -378,11 +581,12 @@ Evaluator::eval(Field_decl const*)
 }
 
 
-// Evaluate the declarations in the module.
+// Evaluate the declarations in the module. This
+// (re-)creates storage for the module's globals.
 void
 Evaluator::eval(Module_decl const* d)
 {
-  Store_sentinel store(*this);
+  allocate(d);
   for (Decl const* d1 : d->declarations())
     eval(d1);
 }
@@ -416,6 +620,10 @@ Evaluator::eval(Stmt const* s, Value& r)
     Control operator()(Declaration_stmt const* s) { return ev.eval(s, r); }
   };
 
+  if (prof) {
+    Profile_sentinel p(prof, s);
+    return apply(s, Fn{*this, r});
+  }
   return apply(s, Fn{*this, r});
 }
 
@@ -427,10 +635,12 @@ Evaluator::eval(Empty_stmt const* s, Value& r)
 }
 
 
+// Note that entering a block does not create storage.
+// The variables of every block are allocated in the
+// frame of the enclosing function.
 Control
 Evaluator::eval(Block_stmt const* s, Value& r)
 {
-  Store_sentinel store(*this);
   for(Stmt const* s1 : s->statements()) {
 
     // Evaluate each statement in turn. If the
@@ -453,7 +663,7 @@ Evaluator::eval(Assign_stmt const* s, Value& r)
 {
   Value lhs = eval(s->object());
   Value rhs = eval(s->value());
-  *lhs.get_reference() = rhs;
+  store(lhs.as_reference(), s->value()->type(), rhs);
   return next_ctl;
 }
 
@@ -461,6 +671,10 @@ Evaluator::eval(Assign_stmt const* s, Value& r)
 Control
 Evaluator::eval(Return_stmt const* s, Value& r)
 {
+  if (Call_expr const* c = as<Call_expr>(s->value())) {
+    if (c->tail())
+      return tail_call(c, r);
+  }
   r = eval(s->value());
   return return_ctl;
 }
@@ -472,7 +686,7 @@ Control
 Evaluator::eval(If_then_stmt const* s, Value& r)
 {
   Value c = eval(s->condition());
-  if (c.get_integer())
+  if (c.as_integer())
     return eval(s->body(), r);
   return next_ctl;
 }
@@ -487,7 +701,7 @@ Control
 Evaluator::eval(If_else_stmt const* s, Value& r)
 {
   Value c = eval(s->condition());
-  if (c.get_integer())
+  if (c.as_integer())
     return eval(s->true_branch(), r);
   else
     return eval(s->false_branch(), r);
@@ -501,7 +715,7 @@ Evaluator::eval(While_stmt const* s, Value& r)
 {
   while (true) {
     Value c = eval(s->condition());
-    if (!c.get_integer())
+    if (!c.as_integer())
       break;
 
     // Evaluate the body. Stop iterating if we got
@@ -512,6 +726,10 @@ Evaluator::eval(While_stmt const* s, Value& r)
       break;
     if (ctl == return_ctl)
       return ctl;
+
+    if (jit)
+      jit->loop(fn);
+    step();
   }
   return next_ctl;
 }
@@ -547,9 +765,150 @@ Evaluator::eval(Declaration_stmt const* s, Value& r)
 }
 
 
+// -------------------------------------------------------------------------- //
+// Memoization
+
+namespace
+{
+
+// Returns true if v can be part of a memo key.
+inline bool
+is_key(Value const& v)
+{
+  return v.is_small() || v.kind() == function_value;
+}
+
+
+inline bool
+same_key(Value const& a, Value const& b)
+{
+  return a.rep() == b.rep();
+}
+
+
+inline std::size_t
+hash_key(Value const& v)
+{
+  return std::hash<std::uintptr_t>()(v.rep());
+}
+
+} // namespace
+
+
+Memo_table::Memo_table(std::size_t n)
+  : table_(std::max<std::size_t>(n, 1))
+  , size_(0)
+  , hits_(0)
+  , misses_(0)
+  , evictions_(0)
+{ }
+
+
+// Returns the entry for a call to f with the n
+// arguments in args.
+Memo_table::Entry&
+Memo_table::entry(Function_decl const* f, Value const* args, std::size_t n)
+{
+  std::size_t h = std::hash<Function_decl const*>()(f);
+  for (std::size_t i = 0; i < n; ++i)
+    h = h * 31 + hash_key(args[i]);
+  return table_[h % table_.size()];
+}
+
+
+// Returns the cached result of calling f with the n
+// arguments in args, or nullptr if there is none.
+Value const*
+Memo_table::find(Function_decl const* f, Value const* args, std::size_t n)
+{
+  if (!std::all_of(args, args + n, is_key))
+    return nullptr;
+  Entry& e = entry(f, args, n);
+  if (e.fn == f && std::equal(args, args + n, e.args.begin(), same_key)) {
+    ++hits_;
+    return &e.result;
+  }
+  ++misses_;
+  return nullptr;
+}
+
+
+// Save the result r of calling f with args.
+void
+Memo_table::insert(Function_decl const* f, Value_seq&& args, Value const& r)
+{
+  if (!std::all_of(args.begin(), args.end(), is_key))
+    return;
+  Entry& e = entry(f, args.data(), args.size());
+  if (e.fn)
+    ++evictions_;
+  else
+    ++size_;
+  e.fn = f;
+  e.args = std::move(args);
+  e.result = r;
+}
+
+
+void
+Memo_table::mark(Box_heap& h) const
+{
+  for (Entry const& e : table_)
+    h.mark(&e.result, &e.result + 1);
+}
+
+
 // -------------------------------------------------------------------------- //
 // Program execution
 
+// Returns the storage for the object declared by d.
+// Global variables are stored in the frame of the
+// module, and all other objects in the current frame.
+Value&
+Evaluator::storage(Decl const* d)
+{
+  if (Variable_decl const* v = as<Variable_decl>(d)) {
+    if (is_global_variable(v))
+      return globals[v->slot()];
+    return frame[v->slot()];
+  }
+  return frame[cast<Parameter_decl>(d)->slot()];
+}
+
+
+// Create storage for the globals of the module d. They
+// are initialized by evaluating their declarations.
+void
+Evaluator::allocate(Module_decl const* d)
+{
+  globals.assign(d->frame_size(), Value());
+}
+
+
+// Returns the storage of the global variable v. An
+// aggregate is stored in the block of values that
+// starts there.
+Value const*
+Evaluator::global(Variable_decl const* v) const
+{
+  return &globals[v->slot()];
+}
+
+
+// Mark the boxes that the program can reach: those of the
+// globals, of every slot the call stack has used, and of
+// the results in the memo table. Slots above the top of
+// the stack hold the aggregate results of calls.
+void
+Evaluator::mark(Box_heap& h) const
+{
+  h.mark(globals.data(), globals.data() + globals.size());
+  h.mark(stack.data(), stack.data() + stack.high_water());
+  if (memo)
+    memo->mark(h);
+}
+
+
 // Execute the given function.
 //
 // TODO: What if there are operands?
@@ -558,16 +917,140 @@ Evaluator::exec(Function_decl const* fn)
 {
   // Evaluate all of the top-level declarations in
   // order to re-establish the evaluation context.
-  Store_sentinel store(*this);
-  Module_decl const* m = cast<Module_decl>(fn->context());
-  for (Decl const* d : m->declarations())
-    eval(d);
+  eval(cast<Module_decl>(fn->context()));
+  return invoke(fn, nullptr, 0);
+}
+
+
+// Call f with the n arguments in args. The globals of
+// the module shall have been evaluated. Each argument
+// shall be a value (not a reference) of the type of its
+// parameter, except that an aggregate argument is a
+// reference to a block, which is copied.
+Value
+Evaluator::invoke(Function_decl const* f, Value const* args, std::size_t n)
+{
+  Decl_seq const& parms = f->parameters();
+  if (n != parms.size())
+    throw std::runtime_error("wrong number of arguments");
+  for (std::size_t i = 0; i < n; ++i) {
+    Type const* t = parms[i]->type();
+    Value_kind k = is<Function_type>(t) ? function_value
+                 : is_aggregate(t) ? reference_value
+                 : integer_value;
+    if (args[i].kind() != k)
+      throw std::runtime_error("invalid argument");
+  }
+
+  Frame_sentinel frame(*this, f);
+  for (std::size_t i = 0; i < n; ++i) {
+    Parameter_decl const* p = cast<Parameter_decl>(parms[i]);
+    store(frame.frame + p->slot(), p->type(), args[i]);
+  }
+  frame.activate();
 
-  // TODO: Check the result code.
   Value result;
-  Control ctl = eval(fn->body(), result);
-  if (ctl != return_ctl)
-    throw std::runtime_error("function error");
+  {
+    Profile_sentinel p(prof, f);
+    Control ctl = eval(f->body(), result);
+    if (ctl != return_ctl)
+      throw std::runtime_error("function error");
+  }
+  return resume(result);
+}
 
-  return result;
+
+namespace
+{
+
+// The state of an evaluation run on the native stack of
+// an evaluator.
+struct Native_task
+{
+  Call_stack&                  stack;
+  Box_heap&                    heap;
+  std::function<void()> const& fn;
+  std::exception_ptr           error;
+  ucontext_t                   caller;
+  ucontext_t                   callee;
+};
+
+
+// The task started by the last switch to a native stack.
+thread_local Native_task* native_task = nullptr;
+
+
+void
+run_task()
+{
+  Native_task& t = *native_task;
+  Box_heap::Scope scope(t.heap);
+  char base;
+  t.stack.native_floor(&base - t.stack.native_size() + Call_stack::native_reserve);
+  try {
+    t.fn();
+  } catch (...) {
+    t.error = std::current_exception();
+  }
+}
+
+} // namespace
+
+
+Evaluator::~Evaluator()
+{
+  if (native)
+    munmap(native, native_size);
+}
+
+
+// Run f, which evaluates with this evaluator. Each nested
+// call recurses on the native stack, so f runs on a stack
+// that is large enough for the depth limit of the call
+// stack. That stack is allocated by the first run, and
+// again only when the depth limit grows. The lowest page
+// is a guard. The heap of the evaluator is current while
+// f runs, and any exception thrown by f is rethrown here.
+// When already on that stack, f is simply called.
+void
+Evaluator::run(std::function<void()> const& f)
+{
+  if (running) {
+    f();
+    return;
+  }
+
+  std::size_t page = sysconf(_SC_PAGESIZE);
+  std::size_t n = stack.native_size() + page;
+  if (native_size < n) {
+    if (native)
+      munmap(native, native_size);
+    void* p = mmap(nullptr, n, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED) {
+      native = nullptr;
+      native_size = 0;
+      throw std::runtime_error("cannot allocate the native stack");
+    }
+    mprotect(p, page, PROT_NONE);
+    native = static_cast<char*>(p);
+    native_size = n;
+  }
+
+  char const* floor = stack.native_floor();
+  Native_task t{stack, heap, f, nullptr};
+  getcontext(&t.callee);
+  t.callee.uc_stack.ss_sp = native + page;
+  t.callee.uc_stack.ss_size = native_size - page;
+  t.callee.uc_link = &t.caller;
+  makecontext(&t.callee, run_task, 0);
+  Native_task* prev = native_task;
+  native_task = &t;
+  running = true;
+  swapcontext(&t.caller, &t.callee);
+  running = false;
+  native_task = prev;
+  stack.native_floor(floor);
+  if (t.error)
+    std::rethrow_exception(t.error);
 }
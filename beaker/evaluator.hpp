@@ -7,21 +7,205 @@
 
 #include "prelude.hpp"
 #include "value.hpp"
-#include "environment.hpp"
+#include "jit.hpp"
+#include "profile.hpp"
 
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <vector>
 
-// Dynamic binding of symbols to their values.
-using Store = Environment<Symbol const*, Value>;
 
-
-// The store stack maintains the dynamic binding
-// between symbols and their values. Each time
-// a new binding environment is entered (e.g., a
-// block scope), a new frame is created to store
-// bindings.
+// The call stack is a single, contiguous region of
+// values that holds the frames of all active calls.
+// A frame stores the values of the parameters and
+// local variables of a call, each in the slot assigned
+// to its declaration during elaboration.
+//
+// Frames are allocated by bumping the top of the stack
+// and released by resetting it, so calls never allocate
+// memory. The region is reserved up front and never
+// moves: references into frames remain valid while the
+// frame is active. Storage is not initialized when a
+// frame is allocated; every object is initialized by
+// its declaration before it can be used.
 //
-// This is also the call stack.
-using Store_stack = Stack<Store>;
+// Each active call also occupies native stack in the
+// evaluator, so the number of frames is limited. The
+// evaluator runs on a native stack sized from that limit
+// (see Evaluator::run). Nested expressions and compiled
+// code also use native stack, and the limit does not
+// count them. So when a native floor is set, each call
+// also checks that the native stack has not reached it.
+class Call_stack
+{
+public:
+  static constexpr std::size_t default_depth = 10000;
+  static constexpr std::size_t native_frame = 4096;     // Bytes per call
+  static constexpr std::size_t native_reserve = 1 << 20; // Bytes below the floor
+
+  Call_stack(std::size_t);
+
+  std::size_t depth_limit() const      { return limit_depth_; }
+  void        depth_limit(std::size_t n) { limit_depth_ = n; }
+
+  std::size_t native_size() const;
+  char const* native_floor() const       { return floor_; }
+  void        native_floor(char const* p) { floor_ = p; }
+
+  Value* push(std::size_t);
+  void   pop(Value*);
+  void   resize(Value*, std::size_t);
+
+  Value* allocate(std::size_t);
+  void   release(Value*);
+
+  Value const* data() const { return base_.get(); }
+
+  // Statistics
+  std::size_t capacity() const   { return limit_ - base_.get(); }
+  std::size_t size() const       { return top_ - base_.get(); }
+  std::size_t high_water() const { return high_ - base_.get(); }
+  std::size_t depth() const      { return depth_; }
+  std::size_t max_depth() const  { return max_depth_; }
+
+private:
+  struct Deleter
+  {
+    void operator()(Value* p) const { ::operator delete(p); }
+  };
+
+  std::unique_ptr<Value, Deleter> base_;
+  Value*                          top_;
+  Value*                          limit_;
+  Value*                          high_;
+  std::size_t                     depth_;
+  std::size_t                     max_depth_;
+  std::size_t                     limit_depth_;
+  char const*                     floor_;
+};
+
+
+// Reserve storage for n values.
+inline
+Call_stack::Call_stack(std::size_t n)
+  : base_(static_cast<Value*>(::operator new(n * sizeof(Value))))
+  , top_(base_.get())
+  , limit_(top_ + n)
+  , high_(top_)
+  , depth_(0)
+  , max_depth_(0)
+  , limit_depth_(default_depth)
+  , floor_(nullptr)
+{ }
+
+
+// Returns the size of the native stack needed to
+// evaluate calls nested up to the depth limit.
+inline std::size_t
+Call_stack::native_size() const
+{
+  return limit_depth_ * native_frame + 2 * native_reserve;
+}
+
+
+// Allocate n values on top of the stack. This does not
+// create a new frame.
+inline Value*
+Call_stack::allocate(std::size_t n)
+{
+  if (std::size_t(limit_ - top_) < n)
+    throw std::runtime_error("stack overflow");
+  Value* p = top_;
+  top_ += n;
+  high_ = std::max(high_, top_);
+  return p;
+}
+
+
+// Release the values allocated at p and above.
+inline void
+Call_stack::release(Value* p)
+{
+  top_ = p;
+}
+
+
+// Allocate a frame of n values. Note that the native
+// stack grows down.
+inline Value*
+Call_stack::push(std::size_t n)
+{
+  if (depth_ == limit_depth_)
+    throw std::runtime_error("maximum call depth exceeded");
+  char here;
+  if (floor_ && &here < floor_)
+    throw std::runtime_error("stack overflow");
+  Value* f = allocate(n);
+  max_depth_ = std::max(max_depth_, ++depth_);
+  return f;
+}
+
+
+// Release the frame f and all frames above it.
+inline void
+Call_stack::pop(Value* f)
+{
+  release(f);
+  --depth_;
+}
+
+
+// Change the size of the frame f to n values. The
+// frame shall be at the top of the stack.
+inline void
+Call_stack::resize(Value* f, std::size_t n)
+{
+  release(f);
+  allocate(n);
+}
+
+
+// The memo table is a bounded cache of the results of
+// calls to pure functions, keyed by the function and the
+// values of its arguments. The table is direct-mapped:
+// each call hashes to a single entry, and a new result
+// replaces whatever that entry held before. Only calls
+// whose arguments are functions or small integers are
+// cached, so a key never refers to a box. The results
+// are marked by the evaluator's heap.
+class Memo_table
+{
+public:
+  Memo_table(std::size_t);
+
+  Value const* find(Function_decl const*, Value const*, std::size_t);
+  void         insert(Function_decl const*, Value_seq&&, Value const&);
+  void         mark(Box_heap&) const;
+
+  // Statistics
+  std::size_t capacity() const  { return table_.size(); }
+  std::size_t size() const      { return size_; }
+  std::size_t hits() const      { return hits_; }
+  std::size_t misses() const    { return misses_; }
+  std::size_t evictions() const { return evictions_; }
+
+private:
+  struct Entry
+  {
+    Function_decl const* fn = nullptr;
+    Value_seq            args;
+    Value                result;
+  };
+
+  Entry& entry(Function_decl const*, Value const*, std::size_t);
+
+  std::vector<Entry> table_;
+  std::size_t        size_;
+  std::size_t        hits_;
+  std::size_t        misses_;
+  std::size_t        evictions_;
+};
 
 
 // Represents the evaluation of a statement.
@@ -38,10 +222,30 @@ enum Control
 
 // The evaluator is responsible for the interpretation
 // of a program as a value.
+//
+// Integer arithmetic is checked by default.
+//
+// When given a JIT, the evaluator reports every call and
+// loop iteration to it, and calls the native code of
+// functions that the JIT has compiled. When given a memo
+// table, the results of calls to pure functions are
+// cached in that table. When given a profiler, every
+// function call and statement is recorded by it.
+//
+// The number of calls and loop iterations may be limited,
+// so that evaluation of a program that might not
+// terminate (e.g., by the compiler) stops with an error.
 class Evaluator
 {
-  struct Store_sentinel;
+  struct Frame_sentinel;
+  struct Profile_sentinel;
 public:
+  Evaluator(std::size_t = 1 << 20,
+            Jit* = nullptr,
+            Memo_table* = nullptr,
+            Profiler* = nullptr);
+  ~Evaluator();
+
   Value eval(Expr const*);
   Value eval(Literal_expr const*);
   Value eval(Id_expr const*);
@@ -62,6 +266,8 @@ public:
   Value eval(Or_expr const*);
   Value eval(Not_expr const*);
   Value eval(Call_expr const*);
+  Value eval(Member_expr const*);
+  Value eval(Index_expr const*);
   Value eval(Value_conv const*);
   Value eval(Default_init const*);
   Value eval(Copy_init const*);
@@ -88,35 +294,132 @@ public:
   Control eval(Declaration_stmt const*, Value&);
 
   Value exec(Function_decl const*);
+  Value invoke(Function_decl const*, Value const*, std::size_t);
+
+  void run(std::function<void()> const&);
+
+  void         allocate(Module_decl const*);
+  Value const* global(Variable_decl const*) const;
+
+  std::size_t step_limit() const      { return limit; }
+  void        step_limit(std::size_t n) { limit = n; steps = 0; }
+
+  Arithmetic arithmetic() const       { return arith; }
+  void       arithmetic(Arithmetic m) { arith = m; }
+
+  Call_stack&       call_stack()       { return stack; }
+  Call_stack const& call_stack() const { return stack; }
+  Box_heap const&   box_heap() const   { return heap; }
+  std::size_t       tail_calls() const { return tails; }
 
 private:
-  Store_stack stack;
+  Value&  storage(Decl const*);
+  void    step();
+  Value   call(Function_decl const*, Native_fn, Call_expr const*, std::size_t);
+  Control tail_call(Call_expr const*, Value&);
+  Value   resume(Value);
+  void    mark(Box_heap&) const;
+
+  Value_seq            globals;          // The frame of the module
+  Call_stack           stack;            // Frames of active calls
+  Box_heap             heap;             // Boxes of large integers
+  Value*               frame = nullptr;  // The frame of the current call
+  Function_decl const* fn = nullptr;     // The function of the current call
+  Function_decl const* tail = nullptr;   // The target of a pending tail call
+  std::size_t          tails = 0;        // Number of tail calls
+  std::size_t          steps = 0;        // Calls and iterations so far
+  std::size_t          limit = 0;        // Limit on steps (0 is none)
+  Jit*                 jit;              // Compiles hot functions
+  Memo_table*          memo;             // Results of pure calls
+  Profiler*            prof;             // Records execution
+  Arithmetic           arith;            // Integer overflow behavior
+  char*                native = nullptr; // The native stack of run()
+  std::size_t          native_size = 0;  // Its size in bytes
+  bool                 running = false;  // True while on that stack
+};
+
+
+// The evaluator reserves space for n values on its
+// call stack. If j is non-null, hot functions are
+// compiled by j. If m is non-null, the results of
+// pure calls are cached in m. If p is non-null, the
+// execution of the program is recorded by p.
+inline
+Evaluator::Evaluator(std::size_t n, Jit* j, Memo_table* m, Profiler* p)
+  : stack(n), heap([this](Box_heap& h) { mark(h); })
+  , jit(j), memo(m), prof(p), arith(checked_arithmetic)
+{ }
+
+
+// Count a call or loop iteration, failing when the
+// step limit, if any, is exceeded.
+inline void
+Evaluator::step()
+{
+  if (limit && ++steps > limit)
+    throw std::runtime_error("evaluation step limit exceeded");
+}
+
+
+// A helper class for managing call frames. This allocates
+// a frame for a call to f on the call stack. The new frame
+// becomes current when activated. On exit, the previous
+// frame is restored and the new frame is released.
+struct Evaluator::Frame_sentinel
+{
+  Frame_sentinel(Evaluator&, Function_decl const*);
+
+  ~Frame_sentinel()
+  {
+    eval.frame = prev;
+    eval.fn = prev_fn;
+    eval.stack.pop(frame);
+  }
+
+  void activate()
+  {
+    eval.frame = frame;
+    eval.fn = fn;
+  }
+
+  Evaluator&           eval;
+  Value*               prev;
+  Function_decl const* prev_fn;
+  Value*               frame;
+  Function_decl const* fn;
 };
 
 
-// A helper class for managing stack frames.
-struct Evaluator::Store_sentinel
+// A helper class for profiling. This records the
+// activation of a function or statement for its
+// lifetime, if the evaluator has a profiler.
+struct Evaluator::Profile_sentinel
 {
-  Store_sentinel(Evaluator& e)
-    : eval(e)
+  template<typename T>
+  Profile_sentinel(Profiler* p, T const* n)
+    : prof(p)
   {
-    eval.stack.push();
+    if (prof)
+      prof->enter(n);
   }
 
-  ~Store_sentinel()
+  ~Profile_sentinel()
   {
-    eval.stack.pop();
+    if (prof)
+      prof->leave();
   }
 
-  Evaluator& eval;
+  Profiler* prof;
 };
 
 
-// Evaluate the given expression.
+// Evaluate the given expression. Note that no call
+// stack is reserved, so the expression shall not
+// contain calls.
 inline Value
 evaluate(Expr const* e)
 {
-  Evaluator ev;
+  Evaluator ev(0);
   return ev.eval(e);
 }
 
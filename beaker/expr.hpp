@@ -18,12 +18,42 @@ struct Expr
   struct Visitor;
   struct Mutator;
 
-  Expr()
-    : type_(nullptr)
+  // The kinds of expressions. The kinds of each family
+  // of expressions are contiguous.
+  enum Kind
+  {
+    literal_expr,
+    id_expr,
+    add_expr,
+    sub_expr,
+    mul_expr,
+    div_expr,
+    rem_expr,
+    eq_expr,
+    ne_expr,
+    lt_expr,
+    gt_expr,
+    le_expr,
+    ge_expr,
+    and_expr,
+    or_expr,
+    neg_expr,
+    pos_expr,
+    not_expr,
+    call_expr,
+    member_expr,
+    index_expr,
+    value_conv,
+    default_init,
+    copy_init,
+  };
+
+  Expr(Kind k)
+    : kind_(k), type_(nullptr)
   { }
 
-  Expr(Type const* t)
-    : type_(t)
+  Expr(Kind k, Type const* t)
+    : kind_(k), type_(t)
   { }
 
   virtual ~Expr() { }
@@ -31,9 +61,11 @@ struct Expr
   virtual void accept(Visitor&) const = 0;
   virtual void accept(Mutator&) = 0;
 
+  Kind        kind() const        { return kind_; }
   Type const* type() const        { return type_; }
   void        type(Type const* t) { type_ = t; }
 
+  Kind        kind_;
   Type const* type_;
 };
 
@@ -61,6 +93,8 @@ struct Expr::Visitor
   virtual void visit(Or_expr const*) = 0;
   virtual void visit(Not_expr const*) = 0;
   virtual void visit(Call_expr const*) = 0;
+  virtual void visit(Member_expr const*) = 0;
+  virtual void visit(Index_expr const*) = 0;
   virtual void visit(Value_conv const*) = 0;
   virtual void visit(Default_init const*) = 0;
   virtual void visit(Copy_init const*) = 0;
@@ -90,6 +124,8 @@ struct Expr::Mutator
   virtual void visit(Or_expr*) = 0;
   virtual void visit(Not_expr*) = 0;
   virtual void visit(Call_expr*) = 0;
+  virtual void visit(Member_expr*) = 0;
+  virtual void visit(Index_expr*) = 0;
   virtual void visit(Value_conv*) = 0;
   virtual void visit(Default_init*) = 0;
   virtual void visit(Copy_init*) = 0;
@@ -105,9 +141,11 @@ struct Expr::Mutator
 struct Literal_expr : Expr
 {
   Literal_expr(Symbol const* s)
-    : sym(s)
+    : Expr(literal_expr), sym(s)
   { }
 
+  static bool classof(Expr const* e) { return e->kind() == literal_expr; }
+
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
 
@@ -125,9 +163,11 @@ struct Literal_expr : Expr
 struct Id_expr : Expr
 {
   Id_expr(Symbol const* s)
-    : sym(s)
+    : Expr(id_expr), sym(s)
   { }
 
+  static bool classof(Expr const* e) { return e->kind() == id_expr; }
+
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
 
@@ -145,10 +185,15 @@ struct Id_expr : Expr
 // A helper class  for unary expressions.
 struct Unary_expr : Expr
 {
-  Unary_expr(Expr* e)
-    : first(e)
+  Unary_expr(Kind k, Expr* e)
+    : Expr(k), first(e)
   { }
 
+  static bool classof(Expr const* e)
+  {
+    return neg_expr <= e->kind() && e->kind() <= not_expr;
+  }
+
   Expr* operand() const { return first; }
 
   Expr* first;
@@ -158,10 +203,15 @@ struct Unary_expr : Expr
 // A helper function for binary expressions.
 struct Binary_expr : Expr
 {
-  Binary_expr(Expr* e1, Expr* e2)
-    : first(e1), second(e2)
+  Binary_expr(Kind k, Expr* e1, Expr* e2)
+    : Expr(k), first(e1), second(e2)
   { }
 
+  static bool classof(Expr const* e)
+  {
+    return add_expr <= e->kind() && e->kind() <= or_expr;
+  }
+
   Expr* left() const { return first; }
   Expr* right() const { return second; }
 
@@ -173,7 +223,11 @@ struct Binary_expr : Expr
 // The expression e1 + e2.
 struct Add_expr : Binary_expr
 {
-  using Binary_expr::Binary_expr;
+  Add_expr(Expr* e1, Expr* e2)
+    : Binary_expr(add_expr, e1, e2)
+  { }
+
+  static bool classof(Expr const* e) { return e->kind() == add_expr; }
 
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
@@ -183,7 +237,11 @@ struct Add_expr : Binary_expr
 // The expression e1 - e2.
 struct Sub_expr : Binary_expr
 {
-  using Binary_expr::Binary_expr;
+  Sub_expr(Expr* e1, Expr* e2)
+    : Binary_expr(sub_expr, e1, e2)
+  { }
+
+  static bool classof(Expr const* e) { return e->kind() == sub_expr; }
 
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
@@ -193,7 +251,11 @@ struct Sub_expr : Binary_expr
 // The expression e1 * e2.
 struct Mul_expr : Binary_expr
 {
-  using Binary_expr::Binary_expr;
+  Mul_expr(Expr* e1, Expr* e2)
+    : Binary_expr(mul_expr, e1, e2)
+  { }
+
+  static bool classof(Expr const* e) { return e->kind() == mul_expr; }
 
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
@@ -203,7 +265,11 @@ struct Mul_expr : Binary_expr
 // The expression e1 / e2.
 struct Div_expr : Binary_expr
 {
-  using Binary_expr::Binary_expr;
+  Div_expr(Expr* e1, Expr* e2)
+    : Binary_expr(div_expr, e1, e2)
+  { }
+
+  static bool classof(Expr const* e) { return e->kind() == div_expr; }
 
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
@@ -213,7 +279,11 @@ struct Div_expr : Binary_expr
 // The expression e1 % e2.
 struct Rem_expr : Binary_expr
 {
-  using Binary_expr::Binary_expr;
+  Rem_expr(Expr* e1, Expr* e2)
+    : Binary_expr(rem_expr, e1, e2)
+  { }
+
+  static bool classof(Expr const* e) { return e->kind() == rem_expr; }
 
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
@@ -223,7 +293,11 @@ struct Rem_expr : Binary_expr
 // The expression -e.
 struct Neg_expr : Unary_expr
 {
-  using Unary_expr::Unary_expr;
+  Neg_expr(Expr* e)
+    : Unary_expr(neg_expr, e)
+  { }
+
+  static bool classof(Expr const* e) { return e->kind() == neg_expr; }
 
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
@@ -233,7 +307,11 @@ struct Neg_expr : Unary_expr
 // The expression +e.
 struct Pos_expr : Unary_expr
 {
-  using Unary_expr::Unary_expr;
+  Pos_expr(Expr* e)
+    : Unary_expr(pos_expr, e)
+  { }
+
+  static bool classof(Expr const* e) { return e->kind() == pos_expr; }
 
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
@@ -243,7 +321,11 @@ struct Pos_expr : Unary_expr
 // The expression e1 == e2.
 struct Eq_expr : Binary_expr
 {
-  using Binary_expr::Binary_expr;
+  Eq_expr(Expr* e1, Expr* e2)
+    : Binary_expr(eq_expr, e1, e2)
+  { }
+
+  static bool classof(Expr const* e) { return e->kind() == eq_expr; }
 
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
@@ -253,7 +335,11 @@ struct Eq_expr : Binary_expr
 // The expression e1 != e2.
 struct Ne_expr : Binary_expr
 {
-  using Binary_expr::Binary_expr;
+  Ne_expr(Expr* e1, Expr* e2)
+    : Binary_expr(ne_expr, e1, e2)
+  { }
+
+  static bool classof(Expr const* e) { return e->kind() == ne_expr; }
 
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
@@ -263,7 +349,11 @@ struct Ne_expr : Binary_expr
 // The expression e1 < e2.
 struct Lt_expr : Binary_expr
 {
-  using Binary_expr::Binary_expr;
+  Lt_expr(Expr* e1, Expr* e2)
+    : Binary_expr(lt_expr, e1, e2)
+  { }
+
+  static bool classof(Expr const* e) { return e->kind() == lt_expr; }
 
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
@@ -273,7 +363,11 @@ struct Lt_expr : Binary_expr
 // The expression e1 > e2.
 struct Gt_expr : Binary_expr
 {
-  using Binary_expr::Binary_expr;
+  Gt_expr(Expr* e1, Expr* e2)
+    : Binary_expr(gt_expr, e1, e2)
+  { }
+
+  static bool classof(Expr const* e) { return e->kind() == gt_expr; }
 
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
@@ -283,7 +377,11 @@ struct Gt_expr : Binary_expr
 // The expression e1 <= e2.
 struct Le_expr : Binary_expr
 {
-  using Binary_expr::Binary_expr;
+  Le_expr(Expr* e1, Expr* e2)
+    : Binary_expr(le_expr, e1, e2)
+  { }
+
+  static bool classof(Expr const* e) { return e->kind() == le_expr; }
 
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
@@ -293,7 +391,11 @@ struct Le_expr : Binary_expr
 // The expression e1 >= e2.
 struct Ge_expr : Binary_expr
 {
-  using Binary_expr::Binary_expr;
+  Ge_expr(Expr* e1, Expr* e2)
+    : Binary_expr(ge_expr, e1, e2)
+  { }
+
+  static bool classof(Expr const* e) { return e->kind() == ge_expr; }
 
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
@@ -303,7 +405,11 @@ struct Ge_expr : Binary_expr
 // The expression e1 && e2.
 struct And_expr : Binary_expr
 {
-  using Binary_expr::Binary_expr;
+  And_expr(Expr* e1, Expr* e2)
+    : Binary_expr(and_expr, e1, e2)
+  { }
+
+  static bool classof(Expr const* e) { return e->kind() == and_expr; }
 
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
@@ -313,7 +419,11 @@ struct And_expr : Binary_expr
 // The expression e1 || e2.
 struct Or_expr : Binary_expr
 {
-  using Binary_expr::Binary_expr;
+  Or_expr(Expr* e1, Expr* e2)
+    : Binary_expr(or_expr, e1, e2)
+  { }
+
+  static bool classof(Expr const* e) { return e->kind() == or_expr; }
 
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
@@ -323,7 +433,11 @@ struct Or_expr : Binary_expr
 // The expression !e.
 struct Not_expr : Unary_expr
 {
-  using Unary_expr::Unary_expr;
+  Not_expr(Expr* e)
+    : Unary_expr(not_expr, e)
+  { }
+
+  static bool classof(Expr const* e) { return e->kind() == not_expr; }
 
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
@@ -331,12 +445,18 @@ struct Not_expr : Unary_expr
 
 
 // The express e(e1, e2, ..., en)
+//
+// A call is a tail call when its result is immediately
+// returned by the calling function. Tail calls are
+// marked during elaboration.
 struct Call_expr : Expr
 {
   Call_expr(Expr* f, Expr_seq const& a)
-    : first(f), second(a)
+    : Expr(call_expr), first(f), second(a), tail_(false)
   { }
 
+  static bool classof(Expr const* e) { return e->kind() == call_expr; }
+
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
 
@@ -346,8 +466,68 @@ struct Call_expr : Expr
   Expr_seq const& arguments() const { return second; }
   Expr_seq&       arguments()       { return second; }
 
+  bool tail() const { return tail_; }
+
   Expr*    first;
   Expr_seq second;
+  bool     tail_;
+};
+
+
+// The expression e.f, which names the field f of the
+// record object e. The field is resolved during
+// elaboration. When e refers to an object, so does
+// the expression.
+struct Member_expr : Expr
+{
+  Member_expr(Expr* e, Symbol const* n)
+    : Expr(member_expr), first(e), second(n), field_(nullptr)
+  { }
+
+  static bool classof(Expr const* e) { return e->kind() == member_expr; }
+
+  void accept(Visitor& v) const { v.visit(this); }
+  void accept(Mutator& v)       { v.visit(this); }
+
+  Expr const*   object() const { return first; }
+  Expr*         object()       { return first; }
+  Symbol const* name() const   { return second; }
+
+  Field_decl const* field() const { return field_; }
+
+  Expr*         first;
+  Symbol const* second;
+  Field_decl*   field_;
+};
+
+
+// The expression e[i], which names the element i of
+// the array object e. When e refers to an object, so
+// does the expression.
+//
+// The index is checked against the extent of the array
+// unless the elaborator can prove that it is in range
+// (see Elaborator::elaborate(While_stmt*)).
+struct Index_expr : Expr
+{
+  Index_expr(Expr* e, Expr* i)
+    : Expr(index_expr), first(e), second(i), checked_(true)
+  { }
+
+  static bool classof(Expr const* e) { return e->kind() == index_expr; }
+
+  void accept(Visitor& v) const { v.visit(this); }
+  void accept(Mutator& v)       { v.visit(this); }
+
+  Expr const* array() const   { return first; }
+  Expr*       array()         { return first; }
+  Expr const* index() const   { return second; }
+  Expr*       index()         { return second; }
+  bool        checked() const { return checked_; }
+
+  Expr* first;
+  Expr* second;
+  bool  checked_;
 };
 
 
@@ -358,10 +538,12 @@ struct Call_expr : Expr
 // a target type.
 struct Conversion : Expr
 {
-  Conversion(Type const* t, Expr* e)
-    : Expr(t), first(e)
+  Conversion(Kind k, Type const* t, Expr* e)
+    : Expr(k, t), first(e)
   { }
 
+  static bool classof(Expr const* e) { return e->kind() == value_conv; }
+
   Expr*       source() const { return first; }
   Type const* target() const { return type(); }
 
@@ -372,7 +554,11 @@ struct Conversion : Expr
 // Represents the conversion of a reference to a value.
 struct Value_conv : Conversion
 {
-  using Conversion::Conversion;
+  Value_conv(Type const* t, Expr* e)
+    : Conversion(value_conv, t, e)
+  { }
+
+  static bool classof(Expr const* e) { return e->kind() == value_conv; }
 
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
@@ -398,10 +584,15 @@ struct Value_conv : Conversion
 // `new (p) T()`.
 struct Initializer : Expr
 {
-  Initializer(Type const* t)
-    : Expr(t)
+  Initializer(Kind k, Type const* t)
+    : Expr(k, t)
   { }
 
+  static bool classof(Expr const* e)
+  {
+    return default_init <= e->kind() && e->kind() <= copy_init;
+  }
+
   Decl const* declaration() const { return decl_; }
 
   Decl const* decl_;
@@ -412,7 +603,11 @@ struct Initializer : Expr
 // of the given type.
 struct Default_init : Initializer
 {
-  using Initializer::Initializer;
+  Default_init(Type const* t)
+    : Initializer(default_init, t)
+  { }
+
+  static bool classof(Expr const* e) { return e->kind() == default_init; }
 
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
@@ -424,9 +619,11 @@ struct Default_init : Initializer
 struct Copy_init : Initializer
 {
   Copy_init(Type const* t, Expr* e)
-    : Initializer(t), first(e)
+    : Initializer(copy_init, t), first(e)
   { }
 
+  static bool classof(Expr const* e) { return e->kind() == copy_init; }
+
   Expr* value() const { return first; }
 
   void accept(Visitor& v) const { v.visit(this); }
@@ -464,18 +661,47 @@ struct Generic_expr_visitor : Expr::Visitor, lingo::Generic_visitor<F, T>
   void visit(Or_expr const* e) { this->invoke(e); }
   void visit(Not_expr const* e) { this->invoke(e); }
   void visit(Call_expr const* e) { this->invoke(e); }
+  void visit(Member_expr const* e) { this->invoke(e); }
+  void visit(Index_expr const* e) { this->invoke(e); }
   void visit(Value_conv const* e) { this->invoke(e); }
   void visit(Default_init const* e) { this->invoke(e); }
   void visit(Copy_init const* e) { this->invoke(e); }
 };
 
 
+// Apply fn to the expression e. Dispatch is by the kind
+// of the expression.
 template<typename F, typename T = typename std::result_of<F(Literal_expr const*)>::type>
 inline T
 apply(Expr const* e, F fn)
 {
-  Generic_expr_visitor<F, T> v(fn);
-  return lingo::accept(e, v);
+  switch (e->kind()) {
+    case Expr::literal_expr: return fn(static_cast<Literal_expr const*>(e));
+    case Expr::id_expr: return fn(static_cast<Id_expr const*>(e));
+    case Expr::add_expr: return fn(static_cast<Add_expr const*>(e));
+    case Expr::sub_expr: return fn(static_cast<Sub_expr const*>(e));
+    case Expr::mul_expr: return fn(static_cast<Mul_expr const*>(e));
+    case Expr::div_expr: return fn(static_cast<Div_expr const*>(e));
+    case Expr::rem_expr: return fn(static_cast<Rem_expr const*>(e));
+    case Expr::neg_expr: return fn(static_cast<Neg_expr const*>(e));
+    case Expr::pos_expr: return fn(static_cast<Pos_expr const*>(e));
+    case Expr::eq_expr: return fn(static_cast<Eq_expr const*>(e));
+    case Expr::ne_expr: return fn(static_cast<Ne_expr const*>(e));
+    case Expr::lt_expr: return fn(static_cast<Lt_expr const*>(e));
+    case Expr::gt_expr: return fn(static_cast<Gt_expr const*>(e));
+    case Expr::le_expr: return fn(static_cast<Le_expr const*>(e));
+    case Expr::ge_expr: return fn(static_cast<Ge_expr const*>(e));
+    case Expr::and_expr: return fn(static_cast<And_expr const*>(e));
+    case Expr::or_expr: return fn(static_cast<Or_expr const*>(e));
+    case Expr::not_expr: return fn(static_cast<Not_expr const*>(e));
+    case Expr::call_expr: return fn(static_cast<Call_expr const*>(e));
+    case Expr::member_expr: return fn(static_cast<Member_expr const*>(e));
+    case Expr::index_expr: return fn(static_cast<Index_expr const*>(e));
+    case Expr::value_conv: return fn(static_cast<Value_conv const*>(e));
+    case Expr::default_init: return fn(static_cast<Default_init const*>(e));
+    case Expr::copy_init: return fn(static_cast<Copy_init const*>(e));
+  }
+  throw std::logic_error("invalid expression kind");
 }
 
 
@@ -509,18 +735,47 @@ struct Generic_expr_mutator : Expr::Mutator, lingo::Generic_mutator<F, T>
   void visit(Or_expr* e) { this->invoke(e); }
   void visit(Not_expr* e) { this->invoke(e); }
   void visit(Call_expr* e) { this->invoke(e); }
+  void visit(Member_expr* e) { this->invoke(e); }
+  void visit(Index_expr* e) { this->invoke(e); }
   void visit(Value_conv* e) { this->invoke(e); }
   void visit(Default_init* e) { this->invoke(e); }
   void visit(Copy_init* e) { this->invoke(e); }
 };
 
 
+// Apply fn to the expression e. Dispatch is by the kind
+// of the expression.
 template<typename F, typename T = typename std::result_of<F(Literal_expr*)>::type>
 inline T
 apply(Expr* e, F fn)
 {
-  Generic_expr_mutator<F, T> v(fn);
-  return lingo::accept(e, v);
+  switch (e->kind()) {
+    case Expr::literal_expr: return fn(static_cast<Literal_expr*>(e));
+    case Expr::id_expr: return fn(static_cast<Id_expr*>(e));
+    case Expr::add_expr: return fn(static_cast<Add_expr*>(e));
+    case Expr::sub_expr: return fn(static_cast<Sub_expr*>(e));
+    case Expr::mul_expr: return fn(static_cast<Mul_expr*>(e));
+    case Expr::div_expr: return fn(static_cast<Div_expr*>(e));
+    case Expr::rem_expr: return fn(static_cast<Rem_expr*>(e));
+    case Expr::neg_expr: return fn(static_cast<Neg_expr*>(e));
+    case Expr::pos_expr: return fn(static_cast<Pos_expr*>(e));
+    case Expr::eq_expr: return fn(static_cast<Eq_expr*>(e));
+    case Expr::ne_expr: return fn(static_cast<Ne_expr*>(e));
+    case Expr::lt_expr: return fn(static_cast<Lt_expr*>(e));
+    case Expr::gt_expr: return fn(static_cast<Gt_expr*>(e));
+    case Expr::le_expr: return fn(static_cast<Le_expr*>(e));
+    case Expr::ge_expr: return fn(static_cast<Ge_expr*>(e));
+    case Expr::and_expr: return fn(static_cast<And_expr*>(e));
+    case Expr::or_expr: return fn(static_cast<Or_expr*>(e));
+    case Expr::not_expr: return fn(static_cast<Not_expr*>(e));
+    case Expr::call_expr: return fn(static_cast<Call_expr*>(e));
+    case Expr::member_expr: return fn(static_cast<Member_expr*>(e));
+    case Expr::index_expr: return fn(static_cast<Index_expr*>(e));
+    case Expr::value_conv: return fn(static_cast<Value_conv*>(e));
+    case Expr::default_init: return fn(static_cast<Default_init*>(e));
+    case Expr::copy_init: return fn(static_cast<Copy_init*>(e));
+  }
+  throw std::logic_error("invalid expression kind");
 }
 
 
@@ -0,0 +1,297 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "fold.hpp"
+#include "type.hpp"
+#include "expr.hpp"
+#include "decl.hpp"
+#include "stmt.hpp"
+#include "token.hpp"
+#include "evaluator.hpp"
+
+#include <string>
+
+
+namespace
+{
+
+inline bool
+is_literal(Expr const* e)
+{
+  return is<Literal_expr>(e);
+}
+
+
+// Returns true if e is the literal b.
+inline bool
+is_literal(Expr const* e, bool b)
+{
+  if (Literal_expr const* lit = as<Literal_expr>(e)) {
+    if (Boolean_sym const* sym = as<Boolean_sym>(lit->symbol()))
+      return sym->value() == b;
+  }
+  return false;
+}
+
+
+// Returns true if e is the integer literal 0.
+inline bool
+is_zero(Expr const* e)
+{
+  if (Literal_expr const* lit = as<Literal_expr>(e)) {
+    if (Integer_sym const* sym = as<Integer_sym>(lit->symbol()))
+      return sym->value() == 0;
+  }
+  return false;
+}
+
+} // namespace
+
+
+// -------------------------------------------------------------------------- //
+// Folding of declarations
+
+void
+Folder::fold(Decl* d)
+{
+  if (Variable_decl* v = as<Variable_decl>(d)) {
+    v->init_ = fold(v->init_);
+  } else if (Function_decl* f = as<Function_decl>(d)) {
+    fold(f->body_);
+  } else if (Module_decl* m = as<Module_decl>(d)) {
+    for (Decl* d1 : m->decls_)
+      fold(d1);
+  }
+}
+
+
+// -------------------------------------------------------------------------- //
+// Folding of statements
+
+void
+Folder::fold(Stmt* s)
+{
+  struct Fn
+  {
+    Folder& f;
+
+    void operator()(Empty_stmt* s) { }
+
+    void operator()(Block_stmt* s)
+    {
+      for (Stmt* s1 : s->first)
+        f.fold(s1);
+    }
+
+    void operator()(Assign_stmt* s)
+    {
+      s->first = f.fold(s->first);
+      s->second = f.fold(s->second);
+    }
+
+    void operator()(Return_stmt* s) { s->first = f.fold(s->first); }
+
+    void operator()(If_then_stmt* s)
+    {
+      s->first = f.fold(s->first);
+      f.fold(s->second);
+    }
+
+    void operator()(If_else_stmt* s)
+    {
+      s->first = f.fold(s->first);
+      f.fold(s->second);
+      f.fold(s->third);
+    }
+
+    void operator()(While_stmt* s)
+    {
+      s->first = f.fold(s->first);
+      f.fold(s->second);
+    }
+
+    void operator()(Break_stmt* s) { }
+    void operator()(Continue_stmt* s) { }
+    void operator()(Expression_stmt* s) { s->first = f.fold(s->first); }
+    void operator()(Declaration_stmt* s) { f.fold(s->first); }
+  };
+
+  apply(s, Fn{*this});
+}
+
+
+// -------------------------------------------------------------------------- //
+// Folding of expressions
+
+// Returns the folded form of e. Operands are folded
+// before their operators.
+Expr*
+Folder::fold(Expr* e)
+{
+  struct Fn
+  {
+    Folder& f;
+
+    Expr* operator()(Literal_expr* e) { return e; }
+    Expr* operator()(Id_expr* e) { return e; }
+    Expr* operator()(Add_expr* e) { return f.fold_binary(e); }
+    Expr* operator()(Sub_expr* e) { return f.fold_binary(e); }
+    Expr* operator()(Mul_expr* e) { return f.fold_binary(e); }
+    Expr* operator()(Div_expr* e) { return f.fold_division(e); }
+    Expr* operator()(Rem_expr* e) { return f.fold_division(e); }
+    Expr* operator()(Neg_expr* e) { return f.fold_unary(e); }
+    Expr* operator()(Pos_expr* e) { return f.fold_unary(e); }
+    Expr* operator()(Eq_expr* e) { return f.fold_binary(e); }
+    Expr* operator()(Ne_expr* e) { return f.fold_binary(e); }
+    Expr* operator()(Lt_expr* e) { return f.fold_binary(e); }
+    Expr* operator()(Gt_expr* e) { return f.fold_binary(e); }
+    Expr* operator()(Le_expr* e) { return f.fold_binary(e); }
+    Expr* operator()(Ge_expr* e) { return f.fold_binary(e); }
+    Expr* operator()(And_expr* e) { return f.fold_and(e); }
+    Expr* operator()(Or_expr* e) { return f.fold_or(e); }
+    Expr* operator()(Not_expr* e) { return f.fold_unary(e); }
+    Expr* operator()(Call_expr* e) { return f.fold_call(e); }
+
+    Expr* operator()(Member_expr* e)
+    {
+      e->first = f.fold(e->first);
+      return e;
+    }
+
+    Expr* operator()(Index_expr* e)
+    {
+      e->first = f.fold(e->first);
+      e->second = f.fold(e->second);
+      return e;
+    }
+
+    Expr* operator()(Value_conv* e)
+    {
+      e->first = f.fold(e->first);
+      return e;
+    }
+
+    Expr* operator()(Default_init* e) { return e; }
+
+    Expr* operator()(Copy_init* e)
+    {
+      e->first = f.fold(e->first);
+      return e;
+    }
+  };
+
+  return apply(e, Fn{*this});
+}
+
+
+Expr*
+Folder::fold_unary(Unary_expr* e)
+{
+  e->first = fold(e->first);
+  if (is_literal(e->first))
+    return replace(e);
+  return e;
+}
+
+
+Expr*
+Folder::fold_binary(Binary_expr* e)
+{
+  e->first = fold(e->first);
+  e->second = fold(e->second);
+  if (is_literal(e->first) && is_literal(e->second))
+    return replace(e);
+  return e;
+}
+
+
+// A division is folded only when its divisor is not 0.
+Expr*
+Folder::fold_division(Binary_expr* e)
+{
+  e->first = fold(e->first);
+  e->second = fold(e->second);
+  if (is_literal(e->first) && is_literal(e->second) && !is_zero(e->second))
+    return replace(e);
+  return e;
+}
+
+
+// When the left operand is false, the expression is
+// false. When it is true, the expression is the right
+// operand.
+Expr*
+Folder::fold_and(And_expr* e)
+{
+  e->first = fold(e->first);
+  e->second = fold(e->second);
+  if (is_literal(e->first, false)) {
+    ++folded_;
+    return e->first;
+  }
+  if (is_literal(e->first, true)) {
+    ++folded_;
+    return e->second;
+  }
+  return e;
+}
+
+
+// When the left operand is true, the expression is
+// true. When it is false, the expression is the right
+// operand.
+Expr*
+Folder::fold_or(Or_expr* e)
+{
+  e->first = fold(e->first);
+  e->second = fold(e->second);
+  if (is_literal(e->first, true)) {
+    ++folded_;
+    return e->first;
+  }
+  if (is_literal(e->first, false)) {
+    ++folded_;
+    return e->second;
+  }
+  return e;
+}
+
+
+// Calls are never folded, but their arguments are.
+Expr*
+Folder::fold_call(Call_expr* e)
+{
+  e->first = fold(e->first);
+  for (Expr*& a : e->second)
+    a = fold(a);
+  return e;
+}
+
+
+// Evaluate the constant expression e and return a
+// literal of the same type with its value.
+Expr*
+Folder::replace(Expr* e)
+{
+  // Expressions that overflow are not folded, so
+  // that they behave as specified by the arithmetic
+  // mode of the program.
+  Value v;
+  try {
+    v = evaluate(e);
+  } catch (std::runtime_error&) {
+    return e;
+  }
+
+  Symbol const* sym;
+  if (is<Boolean_type>(e->type())) {
+    sym = syms.get(v.get_integer() ? "true" : "false");
+  } else {
+    Integer_value n = v.get_integer();
+    sym = syms.put<Integer_sym>(std::to_string(n), integer_tok, n);
+  }
+  Literal_expr* lit = new Literal_expr(sym);
+  lit->type(e->type());
+  ++folded_;
+  return lit;
+}
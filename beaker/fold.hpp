@@ -0,0 +1,56 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef BEAKER_FOLD_HPP
+#define BEAKER_FOLD_HPP
+
+// The folder replaces constant expressions in an
+// elaborated program with literals. An expression is
+// constant when its operands are literals (after
+// folding). Constant expressions are computed by the
+// evaluator, so folding never changes the meaning of a
+// program. In particular, division by 0 and overflow are
+// never folded: the error occurs when the program is run
+// (or not, when arithmetic is unchecked).
+
+#include "prelude.hpp"
+
+
+struct Symbol_table;
+struct Unary_expr;
+struct Binary_expr;
+
+
+class Folder
+{
+public:
+  Folder(Symbol_table&);
+
+  void  fold(Decl*);
+  void  fold(Stmt*);
+  Expr* fold(Expr*);
+
+  // Statistics
+  int folded() const { return folded_; }
+
+private:
+  Expr* fold_unary(Unary_expr*);
+  Expr* fold_binary(Binary_expr*);
+  Expr* fold_division(Binary_expr*);
+  Expr* fold_and(And_expr*);
+  Expr* fold_or(Or_expr*);
+  Expr* fold_call(Call_expr*);
+  Expr* replace(Expr*);
+
+  Symbol_table& syms;
+  int           folded_;
+};
+
+
+inline
+Folder::Folder(Symbol_table& s)
+  : syms(s), folded_(0)
+{ }
+
+
+#endif
@@ -5,16 +5,30 @@
 #include "stmt.hpp"
 #include "decl.hpp"
 #include "evaluator.hpp"
+#include "file.hpp"
 
 #include "llvm/IR/Type.h"
 #include "llvm/IR/GlobalVariable.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Constants.h"
+#include "llvm/IR/DebugInfoMetadata.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Module.h"
+#include "llvm/IR/MDBuilder.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/Linker/Linker.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Transforms/Utils/Local.h"
+#include "llvm/Transforms/Utils/ModuleUtils.h"
 
+#include <algorithm>
+#include <exception>
 #include <iostream>
+#include <limits>
+#include <thread>
 
 
 // -------------------------------------------------------------------------- //
@@ -32,6 +46,161 @@ Generator::make_branch(llvm::BasicBlock* srcBB, llvm::BasicBlock* dstBB)
 }
 
 
+// Returns true if arithmetic operations are checked
+// for overflow. Global initializers have no insertion
+// block, so their operations are never checked.
+bool
+Generator::checked() const
+{
+  return arith == checked_arithmetic && build.GetInsertBlock();
+}
+
+
+// -------------------------------------------------------------------------- //
+//            Debug information
+
+
+// Create the compile unit of the module, if source
+// locations are given. It is named after the file of the
+// first declaration that has one. Beaker has no DWARF
+// language code, so the unit is described as C.
+void
+Generator::begin_debug(Module_decl const* d)
+{
+  if (!locs)
+    return;
+  File const* f = nullptr;
+  for (Decl const* d1 : d->declarations())
+    if ((f = locs->get(d1).file()))
+      break;
+  if (!f)
+    return;
+
+  Path const& p = f->path();
+  debug.reset(new llvm::DIBuilder(*mod));
+  file = debug->createFile(p.filename().string(), p.parent_path().string());
+  unit = debug->createCompileUnit(
+    llvm::dwarf::DW_LANG_C, file, "beaker", level > 0, "", 0, "",
+    llvm::DICompileUnit::LineTablesOnly);
+  mod->addModuleFlag(llvm::Module::Warning, "Dwarf Version", 4);
+  mod->addModuleFlag(llvm::Module::Warning, "Debug Info Version",
+                     llvm::DEBUG_METADATA_VERSION);
+}
+
+
+void
+Generator::end_debug()
+{
+  if (debug)
+    debug->finalize();
+}
+
+
+// Create the subprogram of the function fn, defined by
+// the declaration d. When d is null, the function is
+// artificial, and has no location. Instructions are
+// generated in the subprogram until it is left.
+void
+Generator::describe(llvm::Function* fn, Decl const* d)
+{
+  if (!debug)
+    return;
+  unsigned line = d ? locs->get(d).line() : 0;
+  llvm::DINode::DIFlags flags = d ? llvm::DINode::FlagPrototyped
+                                  : llvm::DINode::FlagArtificial;
+  llvm::DISubprogram::DISPFlags def = llvm::DISubprogram::SPFlagDefinition;
+  if (level > 0)
+    def |= llvm::DISubprogram::SPFlagOptimized;
+  llvm::DISubroutineType* t =
+    debug->createSubroutineType(debug->getOrCreateTypeArray({}));
+  subprogram = debug->createFunction(file, fn->getName(), "", file, line, t,
+                                     line, flags, def);
+  fn->setSubprogram(subprogram);
+  build.SetCurrentDebugLocation(llvm::DILocation::get(cxt, line, 0, subprogram));
+  locate(d);
+}
+
+
+void
+Generator::leave()
+{
+  subprogram = nullptr;
+  build.SetCurrentDebugLocation(llvm::DebugLoc());
+}
+
+
+// Attribute the instructions that follow to the location
+// of the term n, if it has one. Columns are counted from
+// 1 in DWARF, and from 0 by the lexer.
+void
+Generator::locate(void const* n)
+{
+  if (!subprogram)
+    return;
+  Location loc = locs->get(n);
+  if (loc.line() > 0)
+    build.SetCurrentDebugLocation(
+      llvm::DILocation::get(cxt, loc.line(), loc.column() + 1, subprogram));
+}
+
+
+// Generate the overflow intrinsic id for the operands
+// l and r. If the operation overflows, the program
+// traps. Returns the result of the operation.
+llvm::Value*
+Generator::gen_checked(llvm::Intrinsic::ID id, llvm::Value* l, llvm::Value* r)
+{
+  llvm::Function* fn = llvm::Intrinsic::getDeclaration(mod, id, l->getType());
+  llvm::Value* v = build.CreateCall(fn, {l, r});
+  gen_trap(build.CreateExtractValue(v, 1));
+  return build.CreateExtractValue(v, 0);
+}
+
+
+// Generate a branch to a trapping block when c is
+// true. The trap calls the trap function if one has
+// been given, and otherwise executes llvm.trap. The
+// trap function never returns. It does not unwind
+// unless trap_unwinds is set, in which case it may
+// throw through the generated code. Code generation
+// continues in a new block on the normal path.
+void
+Generator::gen_trap(llvm::Value* c)
+{
+  // When the condition is known to be false, there is
+  // nothing to do (e.g., for literal divisors).
+  if (llvm::ConstantInt* k = llvm::dyn_cast<llvm::ConstantInt>(c)) {
+    if (k->isZero())
+      return;
+  }
+
+  llvm::Function* fn = build.GetInsertBlock()->getParent();
+  llvm::BasicBlock* trap = llvm::BasicBlock::Create(cxt, "trap", fn);
+  llvm::BasicBlock* cont = llvm::BasicBlock::Create(cxt, "cont", fn);
+  llvm::MDNode* w = llvm::MDBuilder(cxt).createBranchWeights(1, 1 << 20);
+  build.CreateCondBr(c, trap, cont, w);
+
+  build.SetInsertPoint(trap);
+  llvm::FunctionCallee f;
+  if (trap_fn.empty()) {
+    f = llvm::Intrinsic::getDeclaration(mod, llvm::Intrinsic::trap);
+  } else {
+    llvm::FunctionType* t = llvm::FunctionType::get(build.getVoidTy(), false);
+    std::vector<llvm::Attribute::AttrKind> ks = {llvm::Attribute::NoReturn,
+                                                 llvm::Attribute::Cold};
+    if (!trap_unwinds)
+      ks.push_back(llvm::Attribute::NoUnwind);
+    llvm::AttributeList a = llvm::AttributeList::get(
+      cxt, llvm::AttributeList::FunctionIndex, ks);
+    f = mod->getOrInsertFunction(trap_fn, t, a);
+  }
+  build.CreateCall(f);
+  build.CreateUnreachable();
+
+  build.SetInsertPoint(cont);
+}
+
+
 // Resolve illformed blocks within an llvm function
 // These are blocks with no termination instructions.
 //
@@ -54,7 +223,7 @@ Generator::resolve_illformed_blocks(llvm::Function* fn)
   for (llvm::Function::iterator i = fn->begin(), e = fn->end(); i != e; ++i) {
     // if no terminator inject an unreachable instruction
     if (!i->getTerminator()) {
-      build.SetInsertPoint(i);
+      build.SetInsertPoint(&*i);
       build.CreateUnreachable();
     }
   }
@@ -64,6 +233,169 @@ Generator::resolve_illformed_blocks(llvm::Function* fn)
 }
 
 
+// -------------------------------------------------------------------------- //
+// SSA construction
+//
+// Values of local variables are constructed directly in
+// SSA form, following Braun et al., "Simple and Efficient
+// Construction of Static Single Assignment Form" (2013).
+
+
+// Returns true if the value of d is kept in SSA form. This
+// is the case for locals and parameters of scalar type.
+// Aggregates are stored in memory, since their members
+// and elements are accessed by address.
+bool
+Generator::promoted(Decl const* d) const
+{
+  if (Variable_decl const* v = as<Variable_decl>(d)) {
+    if (is_global_variable(v))
+      return false;
+  } else if (!is<Parameter_decl>(d)) {
+    return false;
+  }
+  Type const* t = d->type();
+  return is<Integer_type>(t) || is<Boolean_type>(t);
+}
+
+
+namespace
+{
+
+// Create an empty phi of type t for d at the start of b.
+llvm::PHINode*
+make_phi(llvm::Type* t, Decl const* d, llvm::BasicBlock* b)
+{
+  llvm::PHINode* phi = llvm::PHINode::Create(t, 0, d->name()->spelling());
+  if (b->empty())
+    b->getInstList().push_back(phi);
+  else
+    phi->insertBefore(&b->front());
+  return phi;
+}
+
+} // namespace
+
+
+// Record v as the value of d at the end of the block b.
+void
+Generator::write_variable(Decl const* d, llvm::BasicBlock* b, llvm::Value* v)
+{
+  defs[d][b] = v;
+}
+
+
+// Returns the value of d at the end of the block b.
+llvm::Value*
+Generator::read_variable(Decl const* d, llvm::BasicBlock* b)
+{
+  Block_defs& ds = defs[d];
+  auto iter = ds.find(b);
+  if (iter != ds.end())
+    return iter->second;
+  return read_variable_recursive(d, b);
+}
+
+
+// Look up the value of d in the predecessors of b. When
+// b has several predecessors, a phi is placed at its
+// start. That phi is recorded as the value of d before
+// its operands are read, which terminates the search
+// around loops.
+llvm::Value*
+Generator::read_variable_recursive(Decl const* d, llvm::BasicBlock* b)
+{
+  llvm::Type* t = get_type(d->type());
+  llvm::Value* v;
+  if (unsealed.count(b)) {
+    llvm::PHINode* phi = make_phi(t, d, b);
+    incomplete[b].emplace_back(d, phi);
+    v = phi;
+  } else if (llvm::BasicBlock* p = b->getSinglePredecessor()) {
+    v = read_variable(d, p);
+  } else if (llvm::pred_empty(b)) {
+    // The block is unreachable.
+    v = llvm::UndefValue::get(t);
+  } else {
+    llvm::PHINode* phi = make_phi(t, d, b);
+    write_variable(d, b, phi);
+    v = add_phi_operands(d, phi);
+  }
+  write_variable(d, b, v);
+  return v;
+}
+
+
+// Add an operand to phi for each predecessor of its block,
+// and remove phi if it turns out to be trivial.
+llvm::Value*
+Generator::add_phi_operands(Decl const* d, llvm::PHINode* phi)
+{
+  llvm::BasicBlock* b = phi->getParent();
+  for (llvm::BasicBlock* p : llvm::predecessors(b))
+    phi->addIncoming(read_variable(d, p), p);
+  return remove_trivial_phi(phi);
+}
+
+
+// A phi is trivial when all of its operands are either
+// the same value or the phi itself. A trivial phi is
+// replaced by that value, and the phis that use it may
+// become trivial in turn.
+llvm::Value*
+Generator::remove_trivial_phi(llvm::PHINode* phi)
+{
+  llvm::Value* same = nullptr;
+  for (llvm::Value* v : phi->incoming_values()) {
+    if (v == same || v == phi)
+      continue;
+    if (same)
+      return phi;
+    same = v;
+  }
+  if (!same)
+    same = llvm::UndefValue::get(phi->getType());
+
+  std::vector<llvm::WeakVH> users;
+  for (llvm::User* u : phi->users())
+    if (u != phi && llvm::isa<llvm::PHINode>(u))
+      users.push_back(u);
+  phi->replaceAllUsesWith(same);
+  phi->eraseFromParent();
+
+  for (llvm::WeakVH& u : users)
+    if (u)
+      remove_trivial_phi(llvm::cast<llvm::PHINode>(u));
+  return same;
+}
+
+
+// All predecessors of b are known. Complete the phis
+// that were created while they were not.
+void
+Generator::seal_block(llvm::BasicBlock* b)
+{
+  Phi_list phis = std::move(incomplete[b]);
+  incomplete.erase(b);
+  unsealed.erase(b);
+  for (auto const& x : phis)
+    add_phi_operands(x.first, x.second);
+}
+
+
+// Continue generating code in a new block. This is used
+// after a statement that transfers control (e.g., return),
+// so that any statements that follow it are well-formed.
+// The block has no predecessors and is removed after the
+// function is generated.
+void
+Generator::start_dead_block()
+{
+  llvm::Function* fn = build.GetInsertBlock()->getParent();
+  build.SetInsertPoint(llvm::BasicBlock::Create(cxt, "dead", fn));
+}
+
+
 // -------------------------------------------------------------------------- //
 // Mapping of types
 //
@@ -83,6 +415,7 @@ Generator::get_type(Type const* t)
     llvm::Type* operator()(Function_type const* t) const { return g.get_type(t); }
     llvm::Type* operator()(Reference_type const* t) const { return g.get_type(t); }
     llvm::Type* operator()(Record_type const* t) const { return g.get_type(t); }
+    llvm::Type* operator()(Array_type const* t) const { return g.get_type(t); }
   };
   return apply(t, Fn{*this});
 }
@@ -108,17 +441,25 @@ Generator::get_type(Boolean_type const*)
 }
 
 
-// Return the 32 bit integer type.
+// Return the 64 bit integer type.
 llvm::Type*
 Generator::get_type(Integer_type const*)
 {
-  return build.getInt32Ty();
+  return build.getInt64Ty();
 }
 
 
-// Return a function type.
+// A value of function type is a pointer to a function.
 llvm::Type*
 Generator::get_type(Function_type const* t)
+{
+  return llvm::PointerType::getUnqual(get_function_type(t));
+}
+
+
+// Return the type of a function.
+llvm::FunctionType*
+Generator::get_function_type(Function_type const* t)
 {
   std::vector<llvm::Type*> ts;
   ts.reserve(t->parameter_types().size());
@@ -150,6 +491,13 @@ Generator::get_type(Record_type const* t)
 }
 
 
+llvm::Type*
+Generator::get_type(Array_type const* t)
+{
+  return llvm::ArrayType::get(get_type(t->type()), t->extent());
+}
+
+
 // -------------------------------------------------------------------------- //
 // Code generation for expressions
 //
@@ -181,6 +529,8 @@ Generator::gen(Expr const* e)
     llvm::Value* operator()(Or_expr const* e) const { return g.gen(e); }
     llvm::Value* operator()(Not_expr const* e) const { return g.gen(e); }
     llvm::Value* operator()(Call_expr const* e) const { return g.gen(e); }
+    llvm::Value* operator()(Member_expr const* e) const { return g.gen(e); }
+    llvm::Value* operator()(Index_expr const* e) const { return g.gen(e); }
     llvm::Value* operator()(Value_conv const* e) const { return g.gen(e); }
     llvm::Value* operator()(Default_init const* e) const { return g.gen(e); }
     llvm::Value* operator()(Copy_init const* e) const { return g.gen(e); }
@@ -191,30 +541,34 @@ Generator::gen(Expr const* e)
 
 
 // Return the value corresponding to a literal expression.
+// Integer literals that do not fit in 64 bits wrap when
+// arithmetic is wrapping, and are otherwise an error.
 llvm::Value*
 Generator::gen(Literal_expr const* e)
 {
-  // TODO: Write better type queries.
-  //
-  // TODO: Write a better interface for values.
-  Value v = evaluate(e);
-  if (e->type() == get_boolean_type())
-    return build.getInt1(v.get_integer());
-  if (e->type() == get_integer_type())
-    return build.getInt32(v.get_integer());
-  else
-    throw std::runtime_error("cannot generate function literal");
+  Symbol const* s = e->symbol();
+  if (Boolean_sym const* b = as<Boolean_sym>(s))
+    return build.getInt1(b->value());
+  if (Integer_sym const* z = as<Integer_sym>(s)) {
+    Integer const& n = z->value();
+    if (!n.is_word() && arith != wrapping_arithmetic)
+      throw std::runtime_error("integer literal '" + n.str() + "' is too large");
+    return build.getInt64(n.wrap());
+  }
+  throw std::runtime_error("cannot generate function literal");
 }
 
 
-// Returns the value associated with the declaration.
-//
-// TODO: Do we need to do anything different for function
-// identifiers or not?
+// Returns the value associated with the declaration. For
+// promoted variables, this is the current value of the
+// variable rather than its address (see Value_conv).
 llvm::Value*
 Generator::gen(Id_expr const* e)
 {
-  return stack.lookup(e->declaration())->second;
+  Decl const* d = e->declaration();
+  if (promoted(d))
+    return read_variable(d, build.GetInsertBlock());
+  return stack.lookup(d)->second;
 }
 
 
@@ -223,6 +577,8 @@ Generator::gen(Add_expr const* e)
 {
   llvm::Value* l = gen(e->left());
   llvm::Value* r = gen(e->right());
+  if (checked())
+    return gen_checked(llvm::Intrinsic::sadd_with_overflow, l, r);
   return build.CreateAdd(l, r);
 }
 
@@ -232,6 +588,8 @@ Generator::gen(Sub_expr const* e)
 {
   llvm::Value* l = gen(e->left());
   llvm::Value* r = gen(e->right());
+  if (checked())
+    return gen_checked(llvm::Intrinsic::ssub_with_overflow, l, r);
   return build.CreateSub(l, r);
 }
 
@@ -241,35 +599,71 @@ Generator::gen(Mul_expr const* e)
 {
   llvm::Value* l = gen(e->left());
   llvm::Value* r = gen(e->right());
+  if (checked())
+    return gen_checked(llvm::Intrinsic::smul_with_overflow, l, r);
   return build.CreateMul(l, r);
 }
 
 
+// Division by 0 traps in either arithmetic mode. The
+// quotient of the least integer and -1 overflows: it
+// traps when arithmetic is checked, and is the negation
+// of the dividend otherwise. LLVM leaves both cases
+// undefined, so a divisor of -1 is replaced by 1 and
+// the quotient is negated. None of these tests are
+// generated when the divisor is a literal.
 llvm::Value*
 Generator::gen(Div_expr const* e)
 {
   llvm::Value* l = gen(e->left());
   llvm::Value* r = gen(e->right());
-  return build.CreateSDiv(l, r);
+  if (!build.GetInsertBlock())
+    return build.CreateSDiv(l, r);
+
+  llvm::Type* t = l->getType();
+  gen_trap(build.CreateICmpEQ(r, llvm::Constant::getNullValue(t)));
+  llvm::Value* m = build.CreateICmpEQ(r, llvm::Constant::getAllOnesValue(t));
+  if (m == build.getFalse())
+    return build.CreateSDiv(l, r);
+  if (checked()) {
+    Integer_value n = std::numeric_limits<Integer_value>::min();
+    llvm::Value* min = llvm::ConstantInt::get(t, n);
+    gen_trap(build.CreateAnd(build.CreateICmpEQ(l, min), m));
+  }
+  llvm::Value* one = llvm::ConstantInt::get(t, 1);
+  llvm::Value* q = build.CreateSDiv(l, build.CreateSelect(m, one, r));
+  return build.CreateSelect(m, build.CreateNeg(q), q);
 }
 
 
-// FIXME: decide on unsigned or signed remainder
-// based on types of expressions
+// Note that int is a signed type. As with division, a
+// divisor of -1 is replaced by 1, since the remainder
+// of any integer and -1 is 0.
 llvm::Value*
 Generator::gen(Rem_expr const* e)
 {
   llvm::Value* l = gen(e->left());
   llvm::Value* r = gen(e->right());
-  return build.CreateURem(l, r);
+  if (!build.GetInsertBlock())
+    return build.CreateSRem(l, r);
+
+  llvm::Type* t = l->getType();
+  gen_trap(build.CreateICmpEQ(r, llvm::Constant::getNullValue(t)));
+  llvm::Value* m = build.CreateICmpEQ(r, llvm::Constant::getAllOnesValue(t));
+  if (m == build.getFalse())
+    return build.CreateSRem(l, r);
+  llvm::Value* one = llvm::ConstantInt::get(t, 1);
+  return build.CreateSRem(l, build.CreateSelect(m, one, r));
 }
 
 
 llvm::Value*
 Generator::gen(Neg_expr const* e)
 {
-  llvm::Value* zero = build.getInt32(0);
   llvm::Value* val = gen(e->operand());
+  llvm::Value* zero = llvm::Constant::getNullValue(val->getType());
+  if (checked())
+    return gen_checked(llvm::Intrinsic::ssub_with_overflow, zero, val);
   return build.CreateSub(zero, val);
 }
 
@@ -335,21 +729,62 @@ Generator::gen(Ge_expr const* e)
 }
 
 
+// The right operand is evaluated only when the left
+// operand is true. The result is false on the edge from
+// the left operand, and the right operand otherwise.
+// Global initializers are constant, and are simply
+// combined.
 llvm::Value*
 Generator::gen(And_expr const* e)
 {
   llvm::Value* l = gen(e->left());
+  if (!build.GetInsertBlock())
+    return build.CreateAnd(l, gen(e->right()));
+
+  llvm::Function* fn = build.GetInsertBlock()->getParent();
+  llvm::BasicBlock* lhs = build.GetInsertBlock();
+  llvm::BasicBlock* rhs = llvm::BasicBlock::Create(cxt, "and.rhs", fn);
+  llvm::BasicBlock* end = llvm::BasicBlock::Create(cxt, "and.end", fn);
+  build.CreateCondBr(l, rhs, end);
+
+  build.SetInsertPoint(rhs);
   llvm::Value* r = gen(e->right());
-  return build.CreateAnd(l, r);
+  rhs = build.GetInsertBlock();
+  build.CreateBr(end);
+
+  build.SetInsertPoint(end);
+  llvm::PHINode* phi = build.CreatePHI(build.getInt1Ty(), 2);
+  phi->addIncoming(build.getFalse(), lhs);
+  phi->addIncoming(r, rhs);
+  return phi;
 }
 
 
+// The right operand is evaluated only when the left
+// operand is false.
 llvm::Value*
 Generator::gen(Or_expr const* e)
 {
   llvm::Value* l = gen(e->left());
+  if (!build.GetInsertBlock())
+    return build.CreateOr(l, gen(e->right()));
+
+  llvm::Function* fn = build.GetInsertBlock()->getParent();
+  llvm::BasicBlock* lhs = build.GetInsertBlock();
+  llvm::BasicBlock* rhs = llvm::BasicBlock::Create(cxt, "or.rhs", fn);
+  llvm::BasicBlock* end = llvm::BasicBlock::Create(cxt, "or.end", fn);
+  build.CreateCondBr(l, end, rhs);
+
+  build.SetInsertPoint(rhs);
   llvm::Value* r = gen(e->right());
-  return build.CreateOr(l, r);
+  rhs = build.GetInsertBlock();
+  build.CreateBr(end);
+
+  build.SetInsertPoint(end);
+  llvm::PHINode* phi = build.CreatePHI(build.getInt1Ty(), 2);
+  phi->addIncoming(build.getTrue(), lhs);
+  phi->addIncoming(r, rhs);
+  return phi;
 }
 
 
@@ -369,6 +804,8 @@ llvm::Value*
 Generator::gen(Call_expr const* e)
 {
   llvm::Value* fn = gen(e->target());
+  Function_type const* t = cast<Function_type>(e->target()->type());
+  llvm::FunctionType* ftype = get_function_type(t);
 
   std::vector<llvm::Value*> argsV;
   for (auto arg : e->arguments()) {
@@ -376,15 +813,66 @@ Generator::gen(Call_expr const* e)
     argsV.push_back(argi);
   }
 
-  return build.CreateCall(fn, argsV, "calltmp");
+  return build.CreateCall(ftype, fn, argsV, "calltmp");
 }
 
 
+// Fields are numbered in declaration order. When the
+// object is a reference, the result is the address of
+// the field. Otherwise, it is the value of the field.
+llvm::Value*
+Generator::gen(Member_expr const* e)
+{
+  Field_decl const* f = e->field();
+  Record_type const* t = cast<Record_type>(e->object()->type()->nonref());
+  Decl_seq const& fs = t->declaration()->fields();
+  unsigned n = std::find(fs.begin(), fs.end(), f) - fs.begin();
+
+  llvm::Value* obj = gen(e->object());
+  if (is<Reference_type>(e->object()->type()))
+    return build.CreateStructGEP(get_type(t), obj, n);
+  return build.CreateExtractValue(obj, n);
+}
+
+
+// When the array is a reference, the result is the
+// address of the element. Otherwise, the array value is
+// stored in a temporary and the result is the value of
+// the element. An index that is out of bounds traps,
+// unless the check was removed during elaboration.
+// Global initializers are never checked.
+llvm::Value*
+Generator::gen(Index_expr const* e)
+{
+  Array_type const* t = cast<Array_type>(e->array()->type()->nonref());
+  llvm::Type* type = get_type(t);
+  llvm::Value* a = gen(e->array());
+  llvm::Value* i = gen(e->index());
+  if (e->checked() && build.GetInsertBlock())
+    gen_trap(build.CreateICmpUGE(i, build.getInt64(t->extent())));
+
+  if (is<Reference_type>(e->array()->type()))
+    return build.CreateInBoundsGEP(type, a, {build.getInt64(0), i});
+
+  llvm::BasicBlock& entry = build.GetInsertBlock()->getParent()->getEntryBlock();
+  llvm::IRBuilder<> tmp(&entry, entry.begin());
+  llvm::Value* p = tmp.CreateAlloca(type);
+  build.CreateStore(a, p);
+  llvm::Value* q = build.CreateInBoundsGEP(type, p, {build.getInt64(0), i});
+  return build.CreateLoad(get_type(t->type()), q);
+}
+
+
+// The value of a promoted variable is read directly.
 llvm::Value*
 Generator::gen(Value_conv const* e)
 {
+  if (Id_expr const* id = as<Id_expr>(e->source())) {
+    if (promoted(id->declaration()))
+      return gen(id);
+  }
   llvm::Value* v = gen(e->source());
-  return build.CreateLoad(v);
+  return build.CreateLoad(get_type(e->type()), v);
 }
 
 
@@ -395,14 +883,15 @@ Generator::gen(Default_init const* e)
   Type const* t = e->type();
   llvm::Type* type = get_type(t);
 
-  // TODO: Scalar types should get a 0 value in the
-  // appropriate type.
+  // Scalar types get a 0 value in the appropriate type.
+  if (is<Integer_type>(t) || is<Boolean_type>(t))
+    return llvm::Constant::getNullValue(type);
 
   // Aggregate types are zero initialized.
   //
   // NOTE: This isn't actually correct. Aggregate types
   // should be memberwise default initialized.
-  if (is<Record_type>(t))
+  if (is_aggregate(t))
     return llvm::ConstantAggregateZero::get(type);
 
   throw std::runtime_error("unhahndled default initializer");
@@ -441,7 +930,47 @@ Generator::gen(Stmt const* s)
     void operator()(Expression_stmt const* s) { g.gen(s); }
     void operator()(Declaration_stmt const* s) { g.gen(s); }
   };
+
+  // The instructions of a statement are attributed to it,
+  // except for those of nested statements. Those that
+  // follow (e.g., the branch back to a loop's condition)
+  // belong to the enclosing statement.
+  llvm::DebugLoc outer = build.getCurrentDebugLocation();
+  locate(s);
   apply(s, Fn{*this});
+  build.SetCurrentDebugLocation(outer);
+}
+
+
+// Generate a branch to t when the condition e is true,
+// and to f otherwise. Chains of && and || become a
+// cascade of branches in which each operand branches
+// directly to its target, negations exchange the
+// targets, and literals are unconditional. Only the
+// conditions at the leaves are computed as values.
+void
+Generator::gen_branch(Expr const* e, llvm::BasicBlock* t, llvm::BasicBlock* f)
+{
+  llvm::Function* fn = build.GetInsertBlock()->getParent();
+  if (And_expr const* a = as<And_expr>(e)) {
+    llvm::BasicBlock* rhs = llvm::BasicBlock::Create(cxt, "and.rhs", fn);
+    gen_branch(a->left(), rhs, f);
+    build.SetInsertPoint(rhs);
+    gen_branch(a->right(), t, f);
+  } else if (Or_expr const* o = as<Or_expr>(e)) {
+    llvm::BasicBlock* rhs = llvm::BasicBlock::Create(cxt, "or.rhs", fn);
+    gen_branch(o->left(), t, rhs);
+    build.SetInsertPoint(rhs);
+    gen_branch(o->right(), t, f);
+  } else if (Not_expr const* n = as<Not_expr>(e)) {
+    gen_branch(n->operand(), f, t);
+  } else {
+    llvm::Value* c = gen(e);
+    if (llvm::ConstantInt* k = llvm::dyn_cast<llvm::ConstantInt>(c))
+      build.CreateBr(k->isZero() ? f : t);
+    else
+      build.CreateCondBr(c, t, f);
+  }
 }
 
 
@@ -471,31 +1000,32 @@ Generator::gen(Block_stmt const* s)
 }
 
 
+// Assignment to a promoted variable defines a new value
+// of that variable in the current block.
 void
 Generator::gen(Assign_stmt const* s)
 {
+  if (Id_expr const* id = as<Id_expr>(s->object())) {
+    if (promoted(id->declaration())) {
+      llvm::Value* rhs = gen(s->value());
+      write_variable(id->declaration(), build.GetInsertBlock(), rhs);
+      return;
+    }
+  }
   llvm::Value* lhs = gen(s->object());
   llvm::Value* rhs = gen(s->value());
   build.CreateStore(rhs, lhs);
 }
 
 
-// When we hit a return stmt we
-// 1. generate the code for the return value
-// 2. store the temp value into the return variable
-// 3. branch to the return block
+// Return the value directly. Any statements that follow
+// are unreachable.
 void
 Generator::gen(Return_stmt const* s)
 {
-  // get the current block
-  auto curr_block = build.GetInsertBlock();
-
-  // check that this will be the only branch
-  // in the block
-
   llvm::Value* v = gen(s->value());
-  build.CreateStore(v, ret_var);
-  make_branch(curr_block, ret_block);
+  build.CreateRet(v);
+  start_dead_block();
 }
 
 
@@ -504,10 +1034,6 @@ Generator::gen(Return_stmt const* s)
 void
 Generator::gen(If_then_stmt const* s)
 {
-  llvm::Value* cond = gen(s->condition());
-
-  cond = build.CreateICmpEQ(cond, build.getTrue(), "ifcond");
-
   llvm::Function* fn = build.GetInsertBlock()->getParent();
 
   // create then block
@@ -515,7 +1041,7 @@ Generator::gen(If_then_stmt const* s)
   // create an empty else block
   llvm::BasicBlock* merge = llvm::BasicBlock::Create(cxt, "cont", fn);
   // create the branch
-  build.CreateCondBr(cond, then, merge);
+  gen_branch(s->condition(), then, merge);
 
   // emit the 'then' block
   build.SetInsertPoint(then);
@@ -533,10 +1059,6 @@ Generator::gen(If_then_stmt const* s)
 void
 Generator::gen(If_else_stmt const* s)
 {
-  llvm::Value* cond = gen(s->condition());
-
-  cond = build.CreateICmpEQ(cond, build.getTrue(), "ifcond");
-
   llvm::Function* fn = build.GetInsertBlock()->getParent();
 
   // create then block
@@ -546,7 +1068,7 @@ Generator::gen(If_else_stmt const* s)
   // create a merge block
   llvm::BasicBlock* merge = llvm::BasicBlock::Create(cxt, "ifcont", fn);
   // create the branch
-  build.CreateCondBr(cond, then, el);
+  gen_branch(s->condition(), then, el);
 
   // emit the 'then' block
   build.SetInsertPoint(then);
@@ -568,6 +1090,9 @@ Generator::gen(If_else_stmt const* s)
 }
 
 
+// The condition block is not sealed until the body has
+// been generated, since continue statements and the end
+// of the body branch back to it.
 void
 Generator::gen(While_stmt const* s)
 {
@@ -575,6 +1100,7 @@ Generator::gen(While_stmt const* s)
 
   // create while block
   llvm::BasicBlock* before_while = llvm::BasicBlock::Create(cxt, "before_while", fn);
+  unsealed.insert(before_while);
   llvm::BasicBlock* while_ = llvm::BasicBlock::Create(cxt, "while", fn);
   llvm::BasicBlock* after_while = llvm::BasicBlock::Create(cxt, "after_while", fn);
 
@@ -587,11 +1113,8 @@ Generator::gen(While_stmt const* s)
 
   // emit the block which evaluates the condition
   build.SetInsertPoint(before_while);
-  // generate the value for the cond
-  llvm::Value* cond = gen(s->condition());
-  // convert cond to boolean i1
-  cond = build.CreateICmpEQ(cond, build.getTrue(), "whilecond");
-  build.CreateCondBr(cond, while_, after_while);
+  // branch on the condition
+  gen_branch(s->condition(), while_, after_while);
 
   // emit the 'while' block
   build.SetInsertPoint(while_);
@@ -600,6 +1123,7 @@ Generator::gen(While_stmt const* s)
   make_branch(build.GetInsertBlock(), before_while);
   // apparently codegen of 'while' can change the current block, update then for the PHI
   while_ = build.GetInsertBlock();
+  seal_block(before_while);
 
   // emit the rest of the code in after_while
   build.SetInsertPoint(after_while);
@@ -617,6 +1141,7 @@ Generator::gen(Break_stmt const* s)
   if (!loop_entry_stack.empty()) {
     llvm::BasicBlock* exit_ = loop_exit_stack.top();
     make_branch(build.GetInsertBlock(), exit_);
+    start_dead_block();
   }
 }
 
@@ -627,6 +1152,7 @@ Generator::gen(Continue_stmt const* s)
   if (!loop_entry_stack.empty()) {
     llvm::BasicBlock* reentry = loop_entry_stack.top();
     make_branch(build.GetInsertBlock(), reentry);
+    start_dead_block();
   }
 }
 
@@ -679,38 +1205,30 @@ Generator::gen(Decl const* d)
 }
 
 
-// We actually cannot generate local variables
-// by injecting them at the beginning block
-// because assignment to memory from prior memory would produce
-// illformed code
+// A promoted local is defined by its initializer. Other
+// locals are allocated at the start of the entry block,
+// so that their storage is not reallocated by loops,
+// and initialized where they are declared.
 void
 Generator::gen_local(Variable_decl const* d)
 {
-  // get the containing function
-  llvm::Function* fn = build.GetInsertBlock()->getParent();
-
-  // get the entry block
-  llvm::BasicBlock& entry_block = fn->getEntryBlock();
-
-  // store the old insert point
-  auto prev = build.GetInsertBlock();
-
-  // if the entry block is empty
-  if (entry_block.empty())
-    build.SetInsertPoint(&entry_block);
-  else
-    build.SetInsertPoint(locals_insert_pt);
+  // generate the initializer first
+  llvm::Value* init = gen(d->init());
+  if (promoted(d)) {
+    // Name the value after the variable, unless it is
+    // already named (e.g., another variable or a parameter).
+    if (llvm::isa<llvm::Instruction>(init) && !init->hasName())
+      init->setName(d->name()->spelling());
+    write_variable(d, build.GetInsertBlock(), init);
+    return;
+  }
 
   // generate the alloca
+  llvm::BasicBlock& entry = build.GetInsertBlock()->getParent()->getEntryBlock();
+  llvm::IRBuilder<> tmp(&entry, entry.begin());
   llvm::Type* t = get_type(d->type());
-  String const& name = d->name()->spelling();
-  llvm::Value* local = build.CreateAlloca(t, nullptr, name);
-
-  // reset the insert point
-  build.SetInsertPoint(prev);
+  llvm::Value* local = tmp.CreateAlloca(t, nullptr, d->name()->spelling());
 
-  // generate the initializer first
-  llvm::Value* init = gen(d->init());
   // generate the store
   build.CreateStore(init, local);
 
@@ -718,26 +1236,15 @@ Generator::gen_local(Variable_decl const* d)
 }
 
 
+// Globals are zero-initialized when they are declared.
+// Their initializers are generated with the module (see
+// gen_init).
 void
 Generator::gen_global(Variable_decl const* d)
 {
   String const&   name = d->name()->spelling();
   llvm::Type*     type = get_type(d->type());
 
-  // FIXME: Handle initialization correctly. If the
-  // initializer is a literal (or a constant expression),
-  // then we should evaluate that and assign it here.
-  llvm::Value* val = gen(d->init());
-  llvm::Constant* init;
-  if (llvm::Constant* c = llvm::dyn_cast<llvm::Constant>(val))
-    init = c;
-  else
-    init = llvm::ConstantInt::get(type, 0);
-
-  // Note that the aggregate 0 only applies to aggregate
-  // types. We can't apply it to initializers for scalars.
-  // llvm::Constant* init = llvm::ConstantAggregateZero::get(type);
-
   // Build the global variable, automatically adding
   // it to the module.
   llvm::GlobalVariable* var = new llvm::GlobalVariable(
@@ -745,7 +1252,7 @@ Generator::gen_global(Variable_decl const* d)
     type,                                  // type
     false,                                 // is constant
     llvm::GlobalVariable::ExternalLinkage, // linkage,
-    init,                                  // initializer
+    llvm::Constant::getNullValue(type),    // initializer
     name                                   // name
   );
 
@@ -754,6 +1261,225 @@ Generator::gen_global(Variable_decl const* d)
 }
 
 
+namespace
+{
+
+// The number of calls and loop iterations allowed in the
+// evaluation of the initializers of a module.
+constexpr std::size_t init_steps = 1 << 20;
+
+
+// Returns true if the evaluation of e cannot write a
+// global variable. That is the case when every call in
+// e names a read-only function.
+bool
+only_reads(Expr const* e)
+{
+  if (Call_expr const* c = as<Call_expr>(e)) {
+    Id_expr const* id = as<Id_expr>(c->target());
+    Function_decl const* f = id ? as<Function_decl>(id->declaration()) : nullptr;
+    if (!f || !f->readonly())
+      return false;
+    for (Expr const* a : c->arguments())
+      if (!only_reads(a))
+        return false;
+    return true;
+  }
+  if (Unary_expr const* u = as<Unary_expr>(e))
+    return only_reads(u->operand());
+  if (Binary_expr const* b = as<Binary_expr>(e))
+    return only_reads(b->left()) && only_reads(b->right());
+  if (Member_expr const* m = as<Member_expr>(e))
+    return only_reads(m->object());
+  if (Index_expr const* i = as<Index_expr>(e))
+    return only_reads(i->array()) && only_reads(i->index());
+  if (Value_conv const* c = as<Value_conv>(e))
+    return only_reads(c->source());
+  if (Copy_init const* c = as<Copy_init>(e))
+    return only_reads(c->value());
+  return true;
+}
+
+
+using Variable_set = std::unordered_set<Decl const*>;
+using Function_set = std::unordered_set<Function_decl const*>;
+
+bool reads(Stmt const*, Variable_set const&, Function_set&);
+
+
+// Returns true if the evaluation of e can read one of the
+// global variables vs, either directly or in a function
+// that it names. The functions in seen have already been
+// searched.
+bool
+reads(Expr const* e, Variable_set const& vs, Function_set& seen)
+{
+  if (Id_expr const* id = as<Id_expr>(e)) {
+    Decl const* d = id->declaration();
+    if (Function_decl const* f = as<Function_decl>(d))
+      return seen.insert(f).second && reads(f->body(), vs, seen);
+    return vs.count(d);
+  }
+  if (Call_expr const* c = as<Call_expr>(e)) {
+    if (reads(c->target(), vs, seen))
+      return true;
+    for (Expr const* a : c->arguments())
+      if (reads(a, vs, seen))
+        return true;
+    return false;
+  }
+  if (Unary_expr const* u = as<Unary_expr>(e))
+    return reads(u->operand(), vs, seen);
+  if (Binary_expr const* b = as<Binary_expr>(e))
+    return reads(b->left(), vs, seen) || reads(b->right(), vs, seen);
+  if (Member_expr const* m = as<Member_expr>(e))
+    return reads(m->object(), vs, seen);
+  if (Index_expr const* i = as<Index_expr>(e))
+    return reads(i->array(), vs, seen) || reads(i->index(), vs, seen);
+  if (Value_conv const* c = as<Value_conv>(e))
+    return reads(c->source(), vs, seen);
+  if (Copy_init const* c = as<Copy_init>(e))
+    return reads(c->value(), vs, seen);
+  return false;
+}
+
+
+bool
+reads(Stmt const* s, Variable_set const& vs, Function_set& seen)
+{
+  if (Block_stmt const* b = as<Block_stmt>(s)) {
+    for (Stmt const* s1 : b->statements())
+      if (reads(s1, vs, seen))
+        return true;
+    return false;
+  }
+  if (Assign_stmt const* a = as<Assign_stmt>(s))
+    return reads(a->object(), vs, seen) || reads(a->value(), vs, seen);
+  if (Return_stmt const* r = as<Return_stmt>(s))
+    return reads(r->value(), vs, seen);
+  if (If_then_stmt const* i = as<If_then_stmt>(s))
+    return reads(i->condition(), vs, seen) || reads(i->body(), vs, seen);
+  if (If_else_stmt const* i = as<If_else_stmt>(s))
+    return reads(i->condition(), vs, seen) ||
+           reads(i->true_branch(), vs, seen) ||
+           reads(i->false_branch(), vs, seen);
+  if (While_stmt const* w = as<While_stmt>(s))
+    return reads(w->condition(), vs, seen) || reads(w->body(), vs, seen);
+  if (Expression_stmt const* e = as<Expression_stmt>(s))
+    return reads(e->expression(), vs, seen);
+  if (Declaration_stmt const* d = as<Declaration_stmt>(s)) {
+    if (Variable_decl const* v = as<Variable_decl>(d->declaration()))
+      return reads(v->init(), vs, seen);
+  }
+  return false;
+}
+
+} // namespace
+
+
+// Returns the constant of type t whose value is stored
+// at p. An aggregate is stored in the block of values
+// that starts at p.
+llvm::Constant*
+Generator::get_constant(Type const* t, Value const* p)
+{
+  if (is<Boolean_type>(t))
+    return build.getInt1(p->get_integer() != 0);
+  if (is<Integer_type>(t))
+    return build.getInt64(p->get_integer());
+  if (is<Function_type>(t))
+    return llvm::cast<llvm::Constant>(stack.lookup(p->get_function())->second);
+
+  std::vector<llvm::Constant*> cs;
+  llvm::Type* type = get_type(t);
+  if (Record_type const* r = as<Record_type>(t)) {
+    for (Decl const* d : r->declaration()->fields()) {
+      Field_decl const* f = cast<Field_decl>(d);
+      cs.push_back(get_constant(f->type(), p + f->offset()));
+    }
+    if (cs.empty())
+      return llvm::Constant::getNullValue(type);
+    return llvm::ConstantStruct::get(llvm::cast<llvm::StructType>(type), cs);
+  }
+  Array_type const* a = cast<Array_type>(t);
+  int n = object_size(a->type());
+  for (int i = 0; i < a->extent(); ++i)
+    cs.push_back(get_constant(a->type(), p + i * n));
+  return llvm::ConstantArray::get(llvm::cast<llvm::ArrayType>(type), cs);
+}
+
+
+// Initialize the global variables of the module d, in
+// order. The evaluator computes the values of as many
+// of them as it can at compile time, and those values
+// become their static initializers. A variable is
+// deferred when its initializer fails, takes too long
+// (the steps are shared by the module), or reads a
+// deferred variable. It is also deferred when it might
+// write another global, and so is every variable that
+// follows it. Deferred variables are initialized at
+// startup, in order, by the function returned, which
+// shall be registered in llvm.global_ctors. If every
+// global has a static initializer, no function is
+// generated.
+llvm::Function*
+Generator::gen_init(Module_decl const* d)
+{
+  std::vector<Variable_decl const*> vars;
+  for (Decl const* d1 : d->declarations())
+    if (Variable_decl const* v = as<Variable_decl>(d1))
+      vars.push_back(v);
+  if (vars.empty())
+    return nullptr;
+
+  Evaluator ev;
+  ev.arithmetic(arith);
+  ev.step_limit(init_steps);
+  ev.allocate(d);
+  Variable_set deferred;
+  std::vector<Variable_decl const*> later;
+  bool writes = false;
+  for (Variable_decl const* v : vars) {
+    Function_set seen;
+    bool known = !writes && only_reads(v->init()) &&
+                 !reads(v->init(), deferred, seen);
+    writes = writes || !only_reads(v->init());
+    if (known) {
+      try {
+        ev.run([&] { ev.eval(v); });
+      } catch (std::runtime_error&) {
+        known = false;
+      }
+    }
+    if (known) {
+      llvm::GlobalVariable* var =
+        llvm::cast<llvm::GlobalVariable>(stack.lookup(v)->second);
+      var->setInitializer(get_constant(v->type(), ev.global(v)));
+    } else {
+      deferred.insert(v);
+      later.push_back(v);
+    }
+  }
+  if (later.empty())
+    return nullptr;
+
+  llvm::FunctionType* t = llvm::FunctionType::get(build.getVoidTy(), false);
+  llvm::Function* fn = llvm::Function::Create(
+    t, llvm::Function::InternalLinkage, "__beaker_init", mod);
+  build.SetInsertPoint(llvm::BasicBlock::Create(cxt, "b", fn));
+  describe(fn, nullptr);
+  for (Variable_decl const* v : later) {
+    locate(v);
+    llvm::Value* init = gen(v->init());
+    build.CreateStore(init, stack.lookup(v)->second);
+  }
+  build.CreateRetVoid();
+  build.ClearInsertionPoint();
+  leave();
+  return fn;
+}
+
+
 // Generate code for a variable declaration. Note that
 // code generation depends heavily on context. Globals
 // and locals are very different.
@@ -772,20 +1498,51 @@ Generator::gen(Variable_decl const* d)
 
 void
 Generator::gen(Function_decl const* d)
+{
+  declare(d);
+  define(d);
+}
+
+
+// Create the function for d, without a body. The
+// attributes inferred during elaboration are attached
+// to the function, so that calls to it can be combined,
+// hoisted out of loops, or deleted.
+llvm::Function*
+Generator::declare(Function_decl const* d)
 {
   String const& name = d->name()->spelling();
-  llvm::Type*   type = get_type(d->type());
 
   // Build the function.
-  llvm::FunctionType* ftype = llvm::cast<llvm::FunctionType>(type);
+  llvm::FunctionType* ftype = get_function_type(d->type());
   llvm::Function* fn = llvm::Function::Create(
     ftype,                           // function type
     llvm::Function::ExternalLinkage, // linkage
     name,                            // name
     mod);                            // owning module
+  if (d->pure())
+    fn->setDoesNotAccessMemory();
+  else if (d->readonly())
+    fn->setOnlyReadsMemory();
+  if (d->nounwind() || !trap_unwinds)
+    fn->setDoesNotThrow();
+  if (d->norecurse())
+    fn->setDoesNotRecurse();
+  if (d->willreturn())
+    fn->addFnAttr(llvm::Attribute::WillReturn);
 
   // Create a new binding for the variable.
   stack.top().bind(d, fn);
+  return fn;
+}
+
+
+// Generate the body of the declared function d, and
+// optimize it, if requested.
+void
+Generator::define(Function_decl const* d)
+{
+  llvm::Function* fn = llvm::cast<llvm::Function>(stack.lookup(d)->second);
 
   // Establish a new binding environment for declarations
   // related to this function.
@@ -817,6 +1574,7 @@ Generator::gen(Function_decl const* d)
   // so that we know where we are.
   llvm::BasicBlock* b = llvm::BasicBlock::Create(cxt, "b", fn);
   build.SetInsertPoint(b);
+  describe(fn, d);
 
   // build the return block for the function
   // it doesnt matter where the block appears
@@ -826,40 +1584,45 @@ Generator::gen(Function_decl const* d)
   for (Decl const* p : d->parameters())
     gen(p);
 
-  // create a variable to store the return
-  llvm::Type* t = get_type(d->return_type());
-  ret_var = build.CreateAlloca(t);
-  // create the return block
-  ret_block = llvm::BasicBlock::Create(cxt, "return");
-
-  // generate an insertion point for all other local variables
-  locals_insert_pt = ret_var;
-
   // Generate the body of the function.
   gen(d->body());
 
-  // generate the final return
-  fn->getBasicBlockList().push_back(ret_block);
-  build.SetInsertPoint(ret_block);
-  llvm::Value* ret_val = build.CreateLoad(ret_var);
-  build.CreateRet(ret_val);
-
-  // handle illformed blocks
+  // handle illformed blocks, and remove those that
+  // follow returns, breaks, and continues.
   resolve_illformed_blocks(fn);
+  llvm::removeUnreachableBlocks(*fn);
+  leave();
+
+  // The values of variables are not needed past the
+  // end of the function.
+  defs.clear();
 
-  // delete the local variable insertion point
-  locals_insert_pt = nullptr;
-  // erase the pointer to the return value
-  ret_var = nullptr;
-  ret_block = nullptr;
+  if (optimize)
+    (*optimize)(fn);
 }
 
 
+// Generate the bodies of the functions fs, in order, on
+// this thread.
+void
+Generator::define(std::vector<Function_decl const*> const& fs)
+{
+  for (Function_decl const* f : fs)
+    define(f);
+}
+
+
+// A promoted parameter is defined by its argument in the
+// entry block. Other parameters are copied to memory.
 void
 Generator::gen(Parameter_decl const* d)
 {
-  llvm::Type* t = get_type(d->type());
   llvm::Value* a = stack.top().get(d).second;
+  if (promoted(d)) {
+    write_variable(d, build.GetInsertBlock(), a);
+    return;
+  }
+  llvm::Type* t = get_type(d->type());
   llvm::Value* v = build.CreateAlloca(t);
   stack.top().rebind(d, v);
   build.CreateStore(a, v);
@@ -881,10 +1644,22 @@ Generator::gen(Record_decl const* d)
       ts.push_back(get_type(f->type()));
   }
 
+  // Records with the same layout share the type of the
+  // first of them. The linker merges such types anyway
+  // (see define_parallel), so sharing them keeps the
+  // module the same however it is generated.
+  for (llvm::StructType* t : records) {
+    if (t->elements() == llvm::makeArrayRef(ts)) {
+      types.bind(d, t);
+      return;
+    }
+  }
+
   // This will automatically be added to the module,
   // but if it's not used, then it won't be generated.
-  llvm::Type* t = llvm::StructType::create(cxt, ts, d->name()->spelling());
+  llvm::StructType* t = llvm::StructType::create(cxt, ts, d->name()->spelling());
   types.bind(d, t);
+  records.push_back(t);
 }
 
 
@@ -895,6 +1670,64 @@ Generator::gen(Field_decl const* d)
 }
 
 
+namespace
+{
+
+// Returns true if t is or contains a record type.
+bool
+has_record(llvm::Type* t)
+{
+  if (llvm::StructType* s = llvm::dyn_cast<llvm::StructType>(t)) {
+    if (!s->isLiteral())
+      return true;
+  }
+  for (llvm::Type* t1 : t->subtypes())
+    if (has_record(t1))
+      return true;
+  return false;
+}
+
+
+// Move the body of f into a new function that replaces
+// it, as the linker does with the functions it links
+// (see define_parallel), so that the module does not
+// depend on the number of threads. Names that are made
+// unique later (e.g., by the optimizer) are numbered in
+// a new symbol table, and poison values of record types
+// become undefined, as when the linker remaps their types.
+void
+move_body(llvm::Function* f)
+{
+  llvm::Function* g = llvm::Function::Create(
+    f->getFunctionType(), f->getLinkage(), f->getAddressSpace(), "",
+    f->getParent());
+  g->copyAttributesFrom(f);
+  g->copyMetadata(f, 0);
+  g->stealArgumentListFrom(*f);
+  g->getBasicBlockList().splice(g->end(), f->getBasicBlockList());
+  g->takeName(f);
+  f->replaceAllUsesWith(g);
+  f->eraseFromParent();
+
+  for (llvm::BasicBlock& b : *g)
+    for (llvm::Instruction& i : b)
+      for (llvm::Use& u : i.operands())
+        if (llvm::isa<llvm::PoisonValue>(u) && has_record(u->getType()))
+          u.set(llvm::UndefValue::get(u->getType()));
+}
+
+} // namespace
+
+
+// Generate the module in two passes. The first declares
+// records, global variables, and functions, and the second
+// generates the bodies of functions, on worker threads when
+// more than one is requested (see define_parallel). Global variables are initialized in
+// between (see gen_init). Finally, functions are put in
+// declaration order, followed by the other declarations
+// (e.g., intrinsics) in order of name, so that the module
+// does not depend on the order in which bodies were
+// generated.
 void
 Generator::gen(Module_decl const* d)
 {
@@ -908,13 +1741,161 @@ Generator::gen(Module_decl const* d)
   // whether we're generating IR or object code?
   assert(!mod);
   mod = new llvm::Module("a.ll", cxt);
+  begin_debug(d);
 
   // Generate all top-level declarations.
-  for (Decl const* d1 : d->declarations())
-    gen(d1);
+  std::vector<Function_decl const*> fs;
+  for (Decl const* d1 : d->declarations()) {
+    if (Function_decl const* f = as<Function_decl>(d1)) {
+      declare(f);
+      fs.push_back(f);
+    } else {
+      gen(d1);
+    }
+  }
+
+  // Generate the initializers of global variables. This
+  // is done before the bodies of functions are linked
+  // into the module, which replaces their declarations.
+  llvm::Function* init = gen_init(d);
 
-  // TODO: Make a second pass to generate global
-  // constructors for initializers.
+  // Generate all function bodies, in this context when
+  // there is only one thread.
+  if (threads > 1) {
+    define_parallel(d, fs);
+  } else {
+    Function_optimizer opt(level);
+    optimize = &opt;
+    define(fs);
+    optimize = nullptr;
+    for (Function_decl const* f : fs)
+      move_body(mod->getFunction(f->name()->spelling()));
+  }
+  if (init)
+    llvm::appendToGlobalCtors(*mod, init, 65535);
+
+  // Remove the declarations that are no longer used
+  // (e.g., of overflow intrinsics whose calls were
+  // folded). Linking drops them anyway.
+  for (auto i = mod->begin(); i != mod->end(); ) {
+    llvm::Function& f = *i++;
+    if (f.isDeclaration() && f.use_empty())
+      f.eraseFromParent();
+  }
+
+  std::vector<llvm::Function*> order;
+  for (Function_decl const* f : fs)
+    order.push_back(mod->getFunction(f->name()->spelling()));
+  std::vector<llvm::Function*> rest;
+  for (llvm::Function& f : *mod)
+    if (std::find(order.begin(), order.end(), &f) == order.end())
+      rest.push_back(&f);
+  std::sort(rest.begin(), rest.end(), [](llvm::Function* a, llvm::Function* b) {
+    return a->getName() < b->getName();
+  });
+  order.insert(order.end(), rest.begin(), rest.end());
+  for (llvm::Function* f : order) {
+    f->removeFromParent();
+    mod->getFunctionList().push_back(f);
+  }
+  end_debug();
+}
+
+
+// Generate the bodies of the functions fs on a number of
+// worker threads. Each worker is given a contiguous range
+// of functions, and a generator in its own context. It
+// declares the module as above, defines its functions,
+// and writes the result as bitcode. The global variables
+// of the worker's module are only declared, so that they
+// resolve to the definitions in this module. The modules
+// are then read into this context and linked, in order,
+// replacing the declarations of the functions they define.
+void
+Generator::define_parallel(Module_decl const* d,
+                           std::vector<Function_decl const*> const& fs)
+{
+  std::size_t n = std::min<std::size_t>(threads, fs.size());
+  std::vector<llvm::SmallVector<char, 0>> code(n);
+  std::vector<std::exception_ptr> errs(n);
+  std::vector<std::thread> workers;
+  for (std::size_t i = 0; i < n; ++i) {
+    workers.emplace_back([&, i]() {
+      try {
+        std::vector<Function_decl const*> part(fs.begin() + i * fs.size() / n,
+                                               fs.begin() + (i + 1) * fs.size() / n);
+        llvm::LLVMContext c;
+        Generator g(c);
+        g.arith = arith;
+        g.trap_fn = trap_fn;
+        g.trap_unwinds = trap_unwinds;
+        g.level = level;
+        g.locs = locs;
+        Function_optimizer opt(level);
+        g.optimize = &opt;
+
+        Symbol_sentinel scope(g);
+        std::unique_ptr<llvm::Module> m(new llvm::Module("a.ll", c));
+        g.mod = m.get();
+        g.begin_debug(d);
+        for (Decl const* d1 : d->declarations()) {
+          if (Function_decl const* f = as<Function_decl>(d1))
+            g.declare(f);
+          else
+            g.gen(d1);
+        }
+        for (llvm::GlobalVariable& v : m->globals())
+          v.setInitializer(nullptr);
+        g.define(part);
+        g.end_debug();
+
+        llvm::raw_svector_ostream os(code[i]);
+        llvm::WriteBitcodeToFile(*m, os, true);
+      } catch (...) {
+        errs[i] = std::current_exception();
+      }
+    });
+  }
+  for (std::thread& t : workers)
+    t.join();
+  for (std::exception_ptr& e : errs)
+    if (e)
+      std::rethrow_exception(e);
+
+  // The linker maps the record types of each module to
+  // those of this module, by name, only when they are used
+  // here. Otherwise, it keeps a renamed copy (e.g., Pt.0).
+  // Record types are used by placeholders until linking
+  // is done.
+  std::vector<llvm::GlobalVariable*> uses;
+  for (llvm::StructType* t : records)
+    uses.push_back(new llvm::GlobalVariable(
+      *mod, t, false, llvm::GlobalVariable::ExternalLinkage, nullptr));
+
+  for (auto const& buf : code) {
+    llvm::MemoryBufferRef ref(llvm::StringRef(buf.data(), buf.size()), "a.ll");
+    llvm::Expected<std::unique_ptr<llvm::Module>> m = llvm::parseBitcodeFile(ref, cxt);
+    if (!m)
+      throw std::runtime_error(llvm::toString(m.takeError()));
+    if (llvm::Linker::linkModules(*mod, std::move(*m)))
+      throw std::runtime_error("cannot link generated functions");
+  }
+
+  for (llvm::GlobalVariable* v : uses)
+    v->eraseFromParent();
+
+  // Each worker describes its functions in a compile unit
+  // of its own, identical to that of this module. Their
+  // subprograms are moved to this module's unit, which is
+  // then the only one.
+  if (debug) {
+    for (llvm::Function& f : *mod)
+      if (llvm::DISubprogram* sp = f.getSubprogram())
+        sp->replaceUnit(unit);
+    llvm::NamedMDNode* cus = mod->getNamedMetadata("llvm.dbg.cu");
+    cus->clearOperands();
+    cus->addOperand(unit);
+  }
 }
 
 
@@ -925,3 +1906,20 @@ Generator::operator()(Decl const* d)
   gen(d);
   return mod;
 }
+
+
+// Generate a module containing only the given functions.
+// The functions shall be given in order of declaration,
+// and they shall not refer to any declaration outside
+// of that set.
+llvm::Module*
+Generator::operator()(std::vector<Function_decl const*> const& fns)
+{
+  Symbol_sentinel scope(*this);
+
+  assert(!mod);
+  mod = new llvm::Module("a.ll", cxt);
+  for (Function_decl const* f : fns)
+    gen(f);
+  return mod;
+}
@@ -8,10 +8,21 @@
 
 #include "prelude.hpp"
 #include "environment.hpp"
+#include "location.hpp"
+#include "value.hpp"
+#include "optimizer.hpp"
 
+#include <llvm/IR/DIBuilder.h>
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Intrinsics.h>
+#include <llvm/IR/ValueHandle.h>
+#include <memory>
 #include <stack>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 
 // Used to maintain a mapping of Beaker declarations
@@ -36,16 +47,20 @@ using Type_env = Environment<Decl const*, llvm::Type*>;
 struct Generator
 {
   Generator();
+  Generator(llvm::LLVMContext&);
 
   llvm::Module* operator()(Decl const*);
+  llvm::Module* operator()(std::vector<Function_decl const*> const&);
 
   llvm::Type* get_type(Type const*);
   llvm::Type* get_type(Id_type const*);
   llvm::Type* get_type(Boolean_type const*);
   llvm::Type* get_type(Integer_type const*);
   llvm::Type* get_type(Function_type const*);
+  llvm::FunctionType* get_function_type(Function_type const*);
   llvm::Type* get_type(Reference_type const*);
   llvm::Type* get_type(Record_type const*);
+  llvm::Type* get_type(Array_type const*);
 
   llvm::Value* gen(Expr const*);
   llvm::Value* gen(Literal_expr const*);
@@ -67,10 +82,14 @@ struct Generator
   llvm::Value* gen(Or_expr const*);
   llvm::Value* gen(Not_expr const*);
   llvm::Value* gen(Call_expr const*);
+  llvm::Value* gen(Member_expr const*);
+  llvm::Value* gen(Index_expr const*);
   llvm::Value* gen(Value_conv const*);
   llvm::Value* gen(Default_init const*);
   llvm::Value* gen(Copy_init const*);
 
+  void gen_branch(Expr const*, llvm::BasicBlock*, llvm::BasicBlock*);
+
   void gen(Stmt const*);
   void gen(Empty_stmt const*);
   void gen(Block_stmt const*);
@@ -94,9 +113,34 @@ struct Generator
 
   void gen_local(Variable_decl const*);
   void gen_global(Variable_decl const*);
+  llvm::Function* gen_init(Module_decl const*);
+
+  llvm::Constant* get_constant(Type const*, Value const*);
+
+  // Functions are declared before they are defined, so
+  // that the bodies of a module's functions can be
+  // generated in any order, and in parallel.
+  llvm::Function* declare(Function_decl const*);
+  void            define(Function_decl const*);
+  void            define(std::vector<Function_decl const*> const&);
+  void            define_parallel(Module_decl const*,
+                                  std::vector<Function_decl const*> const&);
+
+  // Debug information
+  void begin_debug(Module_decl const*);
+  void end_debug();
+  void describe(llvm::Function*, Decl const*);
+  void leave();
+  void locate(void const*);
 
-  llvm::LLVMContext cxt;
-  llvm::IRBuilder<> build;
+  // Checked arithmetic
+  bool         checked() const;
+  llvm::Value* gen_checked(llvm::Intrinsic::ID, llvm::Value*, llvm::Value*);
+  void         gen_trap(llvm::Value*);
+
+  std::unique_ptr<llvm::LLVMContext> own;
+  llvm::LLVMContext& cxt;
+  llvm::IRBuilder<>  build;
   llvm::Module*     mod;
 
   // Helper functions for determining where
@@ -109,26 +153,100 @@ struct Generator
   // keep track of the current loop exit
   std::stack<llvm::BasicBlock*> loop_exit_stack;
 
-  // points to the beginning of the entry block
-  // so we can insert isntructions here
-  llvm::Instruction* locals_insert_pt;
+  // SSA construction. Scalar locals and parameters are
+  // not stored in memory. Their values are tracked per
+  // block, and phi nodes are created on demand when a
+  // value is read in a block with several predecessors.
+  // A block is sealed when all of its predecessors are
+  // known; until then, reads create incomplete phis
+  // whose operands are added when the block is sealed.
+  // Only loop headers are created unsealed.
+  //
+  // Definitions are held by value handles so that they
+  // follow the replacement of trivial phis.
+  using Block_defs = std::unordered_map<llvm::BasicBlock*, llvm::WeakTrackingVH>;
+  using Phi_list = std::vector<std::pair<Decl const*, llvm::PHINode*>>;
 
-  // maintain the block which contains our one return statement 
-  llvm::BasicBlock* ret_block;
+  bool         promoted(Decl const*) const;
+  void         write_variable(Decl const*, llvm::BasicBlock*, llvm::Value*);
+  llvm::Value* read_variable(Decl const*, llvm::BasicBlock*);
+  llvm::Value* read_variable_recursive(Decl const*, llvm::BasicBlock*);
+  llvm::Value* add_phi_operands(Decl const*, llvm::PHINode*);
+  llvm::Value* remove_trivial_phi(llvm::PHINode*);
+  void         seal_block(llvm::BasicBlock*);
+  void         start_dead_block();
 
-  // points to the current return value
-  llvm::Instruction* ret_var;
+  std::unordered_map<Decl const*, Block_defs>  defs;
+  std::unordered_map<llvm::BasicBlock*, Phi_list> incomplete;
+  std::unordered_set<llvm::BasicBlock*>        unsealed;
 
   Symbol_stack      stack;
   Type_env          types;
 
+  // The distinct types of records, in declaration order.
+  std::vector<llvm::StructType*> records;
+
+  // The arithmetic mode of generated code. When
+  // arithmetic is checked, operations that overflow
+  // call the trap function, if one is given, and
+  // execute llvm.trap otherwise. The trap function
+  // may unwind (e.g., by throwing an exception to the
+  // interpreter), in which case so may the functions
+  // that reach a runtime check.
+  Arithmetic arith;
+  String     trap_fn;
+  bool       trap_unwinds;
+
+  // The optimization level of function bodies (see
+  // Function_optimizer), and the number of threads that
+  // generate them. The module is the same for any number
+  // of threads.
+  int                 level;
+  int                 threads;
+  Function_optimizer* optimize;
+
+  // When source locations are given, the module carries
+  // debug information: a compile unit, a subprogram for
+  // each function, and the line and column of the
+  // statement that each instruction was generated for.
+  // Only line tables are described (not types or
+  // variables), so that they can be kept in optimized
+  // code at little cost.
+  Location_map const*              locs;
+  std::unique_ptr<llvm::DIBuilder> debug;
+  llvm::DICompileUnit*             unit;
+  llvm::DIFile*                    file;
+  llvm::DISubprogram*              subprogram;
+
   struct Symbol_sentinel;
 };
 
 
 inline
 Generator::Generator()
-  : cxt(), build(cxt), mod(nullptr)
+  : own(new llvm::LLVMContext())
+  , cxt(*own)
+  , build(cxt)
+  , mod(nullptr)
+  , arith(checked_arithmetic)
+  , trap_unwinds(false)
+  , level(0)
+  , threads(1)
+  , optimize(nullptr)
+  , locs(nullptr)
+  , unit(nullptr)
+  , file(nullptr)
+  , subprogram(nullptr)
+{ }
+
+
+// Generate code in the context c. The context must
+// outlive the generator and the modules it creates.
+inline
+Generator::Generator(llvm::LLVMContext& c)
+  : cxt(c), build(cxt), mod(nullptr), arith(checked_arithmetic)
+  , trap_unwinds(false), level(0), threads(1), optimize(nullptr)
+  , locs(nullptr), unit(nullptr), file(nullptr), subprogram(nullptr)
 { }
 
 
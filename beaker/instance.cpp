@@ -0,0 +1,57 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "instance.hpp"
+#include "decl.hpp"
+
+
+// Create an instance of the module m and evaluate its
+// globals. The remaining arguments configure the
+// evaluator (see Evaluator). Globals are evaluated in
+// the arithmetic mode a.
+Module_instance::Module_instance(Module_decl const* m,
+                                 std::size_t n,
+                                 Jit* j,
+                                 Memo_table* c,
+                                 Profiler* p,
+                                 Arithmetic a)
+  : mod(m), ev(n, j, c, p)
+{
+  ev.arithmetic(a);
+  reset();
+}
+
+
+// Returns the function named n, or nullptr if the module
+// has no such function.
+Function_decl const*
+Module_instance::function(String const& n) const
+{
+  for (Decl const* d : mod->declarations()) {
+    if (Function_decl const* f = as<Function_decl>(d)) {
+      if (f->name()->spelling() == n)
+        return f;
+    }
+  }
+  return nullptr;
+}
+
+
+// Call the function named n with the given arguments.
+Value
+Module_instance::call(String const& n, Value_seq const& args)
+{
+  Function_decl const* f = function(n);
+  if (!f)
+    throw std::runtime_error("no function '" + n + "'");
+  return call(f, args);
+}
+
+
+// Re-evaluate the globals of the module, discarding
+// their current values.
+void
+Module_instance::reset()
+{
+  ev.run([this] { ev.eval(mod); });
+}
@@ -0,0 +1,59 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef BEAKER_INSTANCE_HPP
+#define BEAKER_INSTANCE_HPP
+
+// A module instance is an evaluated module. The global
+// variables of the module are evaluated once, when the
+// instance is created, and the resulting store persists
+// for the lifetime of the instance. Any function of the
+// module can then be called any number of times.
+//
+// Note that the store is shared by every call: a call
+// that modifies a global variable is observed by all
+// subsequent calls. Use reset() to re-evaluate the
+// globals. A large integer returned by a call is owned
+// by the instance, and is valid until the next call.
+
+#include "evaluator.hpp"
+
+
+class Module_instance
+{
+public:
+  Module_instance(Module_decl const*,
+                  std::size_t = 1 << 20,
+                  Jit* = nullptr,
+                  Memo_table* = nullptr,
+                  Profiler* = nullptr,
+                  Arithmetic = checked_arithmetic);
+
+  Module_decl const*   module() const { return mod; }
+  Function_decl const* function(String const&) const;
+
+  Value call(Function_decl const*, Value_seq const& = {});
+  Value call(String const&, Value_seq const& = {});
+
+  void reset();
+
+  Evaluator&       evaluator()       { return ev; }
+  Evaluator const& evaluator() const { return ev; }
+
+private:
+  Module_decl const* mod;
+  Evaluator          ev;
+};
+
+
+// Call the function f with the given arguments.
+inline Value
+Module_instance::call(Function_decl const* f, Value_seq const& args)
+{
+  Value v;
+  ev.run([&] { v = ev.invoke(f, args.data(), args.size()); });
+  return v;
+}
+
+
+#endif
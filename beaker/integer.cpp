@@ -0,0 +1,510 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "integer.hpp"
+
+#include <functional>
+#include <iostream>
+#include <limits>
+
+
+namespace
+{
+
+using Word = Integer::Word;
+using Limb = Integer::Limb;
+using Limb_seq = Integer::Limb_seq;
+
+constexpr int limb_bits = 32;
+constexpr std::uint64_t limb_base = std::uint64_t(1) << limb_bits;
+
+
+// -------------------------------------------------------------------------- //
+// Magnitudes
+//
+// A magnitude is a sequence of limbs, ordered from
+// least to most significant. A magnitude is trimmed
+// when its most significant limb is not 0. The
+// magnitude of 0 is empty.
+
+void
+trim(Limb_seq& a)
+{
+  while (!a.empty() && a.back() == 0)
+    a.pop_back();
+}
+
+
+// Returns the magnitude of the word u.
+Limb_seq
+magnitude(std::uint64_t u)
+{
+  Limb_seq a;
+  while (u) {
+    a.push_back(Limb(u));
+    u >>= limb_bits;
+  }
+  return a;
+}
+
+
+// Compare the trimmed magnitudes a and b.
+int
+compare_mag(Limb_seq const& a, Limb_seq const& b)
+{
+  if (a.size() != b.size())
+    return a.size() < b.size() ? -1 : 1;
+  for (std::size_t i = a.size(); i-- > 0;) {
+    if (a[i] != b[i])
+      return a[i] < b[i] ? -1 : 1;
+  }
+  return 0;
+}
+
+
+Limb_seq
+add_mag(Limb_seq const& a, Limb_seq const& b)
+{
+  Limb_seq const& x = a.size() >= b.size() ? a : b;
+  Limb_seq const& y = a.size() >= b.size() ? b : a;
+  Limb_seq r(x.size() + 1);
+  std::uint64_t k = 0;
+  for (std::size_t i = 0; i < x.size(); ++i) {
+    std::uint64_t t = std::uint64_t(x[i]) + (i < y.size() ? y[i] : 0) + k;
+    r[i] = Limb(t);
+    k = t >> limb_bits;
+  }
+  r[x.size()] = Limb(k);
+  trim(r);
+  return r;
+}
+
+
+// Returns a - b. The magnitude a shall not be less
+// than b.
+Limb_seq
+sub_mag(Limb_seq const& a, Limb_seq const& b)
+{
+  Limb_seq r(a.size());
+  std::int64_t k = 0;
+  for (std::size_t i = 0; i < a.size(); ++i) {
+    std::int64_t t = std::int64_t(a[i]) - (i < b.size() ? b[i] : 0) - k;
+    k = t < 0;
+    r[i] = Limb(t + (k ? limb_base : 0));
+  }
+  trim(r);
+  return r;
+}
+
+
+Limb_seq
+mul_mag(Limb_seq const& a, Limb_seq const& b)
+{
+  if (a.empty() || b.empty())
+    return {};
+  Limb_seq r(a.size() + b.size());
+  for (std::size_t i = 0; i < a.size(); ++i) {
+    std::uint64_t k = 0;
+    for (std::size_t j = 0; j < b.size(); ++j) {
+      std::uint64_t t = std::uint64_t(a[i]) * b[j] + r[i + j] + k;
+      r[i + j] = Limb(t);
+      k = t >> limb_bits;
+    }
+    r[i + b.size()] = Limb(k);
+  }
+  trim(r);
+  return r;
+}
+
+
+// Divide the magnitude a by the limb d, returning the
+// quotient and storing the remainder in rem.
+Limb_seq
+div_limb(Limb_seq const& a, Limb d, Limb& rem)
+{
+  Limb_seq q(a.size());
+  std::uint64_t k = 0;
+  for (std::size_t i = a.size(); i-- > 0;) {
+    std::uint64_t t = (k << limb_bits) | a[i];
+    q[i] = Limb(t / d);
+    k = t % d;
+  }
+  rem = Limb(k);
+  trim(q);
+  return q;
+}
+
+
+// Compute the quotient and remainder of the magnitudes
+// u and v. The divisor shall not be 0. This is Knuth's
+// Algorithm D (TAOCP 4.3.1).
+void
+divide_mag(Limb_seq const& u, Limb_seq const& v, Limb_seq& q, Limb_seq& r)
+{
+  if (compare_mag(u, v) < 0) {
+    q.clear();
+    r = u;
+    return;
+  }
+  if (v.size() == 1) {
+    Limb k;
+    q = div_limb(u, v[0], k);
+    r = magnitude(k);
+    return;
+  }
+
+  // Normalize so that the most significant limb of
+  // the divisor has its high bit set.
+  std::size_t m = u.size();
+  std::size_t n = v.size();
+  int s = __builtin_clz(v.back());
+  Limb_seq vn(n);
+  Limb_seq un(m + 1);
+  for (std::size_t i = n - 1; i > 0; --i)
+    vn[i] = (v[i] << s) | (s ? v[i - 1] >> (limb_bits - s) : 0);
+  vn[0] = v[0] << s;
+  un[m] = s ? u[m - 1] >> (limb_bits - s) : 0;
+  for (std::size_t i = m - 1; i > 0; --i)
+    un[i] = (u[i] << s) | (s ? u[i - 1] >> (limb_bits - s) : 0);
+  un[0] = u[0] << s;
+
+  q.assign(m - n + 1, 0);
+  for (std::size_t j = m - n + 1; j-- > 0;) {
+    // Estimate the quotient digit, which is at most
+    // two greater than the actual digit.
+    std::uint64_t num = (std::uint64_t(un[j + n]) << limb_bits) | un[j + n - 1];
+    std::uint64_t qhat = num / vn[n - 1];
+    std::uint64_t rhat = num % vn[n - 1];
+    while (qhat >= limb_base
+        || qhat * vn[n - 2] > ((rhat << limb_bits) | un[j + n - 2])) {
+      --qhat;
+      rhat += vn[n - 1];
+      if (rhat >= limb_base)
+        break;
+    }
+
+    // Multiply and subtract.
+    std::int64_t k = 0;
+    std::int64_t t;
+    for (std::size_t i = 0; i < n; ++i) {
+      std::uint64_t p = qhat * vn[i];
+      t = std::int64_t(un[i + j]) - k - std::int64_t(p & 0xffffffff);
+      un[i + j] = Limb(t);
+      k = std::int64_t(p >> limb_bits) - (t >> limb_bits);
+    }
+    t = std::int64_t(un[j + n]) - k;
+    un[j + n] = Limb(t);
+
+    // If the result is negative, the estimate was one
+    // too large, so add the divisor back.
+    q[j] = Limb(qhat);
+    if (t < 0) {
+      --q[j];
+      std::uint64_t c = 0;
+      for (std::size_t i = 0; i < n; ++i) {
+        std::uint64_t x = std::uint64_t(un[i + j]) + vn[i] + c;
+        un[i + j] = Limb(x);
+        c = x >> limb_bits;
+      }
+      un[j + n] += Limb(c);
+    }
+  }
+
+  // Unnormalize the remainder.
+  r.resize(n);
+  for (std::size_t i = 0; i < n - 1; ++i)
+    r[i] = (un[i] >> s) | (s ? un[i + 1] << (limb_bits - s) : 0);
+  r[n - 1] = un[n - 1] >> s;
+  trim(q);
+  trim(r);
+}
+
+} // namespace
+
+
+// -------------------------------------------------------------------------- //
+// Integers
+
+// Construct the integer with sign neg and the magnitude
+// a. The result is a word if it fits.
+Integer::Integer(bool neg, Limb_seq&& a)
+  : word_(0), neg_(false)
+{
+  trim(a);
+  if (a.size() <= 2) {
+    std::uint64_t u = a.empty() ? 0 : a[0];
+    if (a.size() == 2)
+      u |= std::uint64_t(a[1]) << limb_bits;
+    std::uint64_t max = std::numeric_limits<Word>::max();
+    if (u <= max) {
+      word_ = neg ? -Word(u) : Word(u);
+      return;
+    }
+    if (neg && u == max + 1) {
+      word_ = std::numeric_limits<Word>::min();
+      return;
+    }
+  }
+  neg_ = neg;
+  mag_ = std::move(a);
+}
+
+
+// Construct an integer from a sequence of decimal
+// digits, optionally preceded by a minus sign.
+Integer::Integer(String const& s)
+  : word_(0), neg_(false)
+{
+  std::size_t i = 0;
+  bool neg = !s.empty() && s[0] == '-';
+  if (neg)
+    ++i;
+  if (i == s.size())
+    throw std::runtime_error("invalid integer '" + s + "'");
+
+  // Accumulate 9 digits at a time.
+  Limb_seq a;
+  while (i < s.size()) {
+    std::size_t n = std::min<std::size_t>(9, s.size() - i);
+    Limb chunk = 0;
+    Limb scale = 1;
+    for (std::size_t j = 0; j < n; ++j) {
+      char c = s[i + j];
+      if (!std::isdigit(c))
+        throw std::runtime_error("invalid integer '" + s + "'");
+      chunk = chunk * 10 + (c - '0');
+      scale *= 10;
+    }
+    a = add_mag(mul_mag(a, {scale}), magnitude(chunk));
+    i += n;
+  }
+  *this = Integer(neg, std::move(a));
+}
+
+
+// Store the sign and magnitude of the integer.
+void
+Integer::split(bool& neg, Limb_seq& a) const
+{
+  if (is_word()) {
+    neg = word_ < 0;
+    std::uint64_t u = word_;
+    a = magnitude(neg ? 0 - u : u);
+  } else {
+    neg = neg_;
+    a = mag_;
+  }
+}
+
+
+// Returns the value modulo 2^64, as a word.
+Integer::Word
+Integer::wrap() const
+{
+  if (is_word())
+    return word_;
+  std::uint64_t u = std::uint64_t(mag_[0]) | std::uint64_t(mag_[1]) << limb_bits;
+  return Word(neg_ ? 0 - u : u);
+}
+
+
+// Returns -1, 0, or 1 according to the sign of the
+// integer.
+int
+Integer::sign() const
+{
+  if (is_word())
+    return (word_ > 0) - (word_ < 0);
+  return neg_ ? -1 : 1;
+}
+
+
+std::size_t
+Integer::hash() const
+{
+  std::hash<Word> h;
+  if (is_word())
+    return h(word_);
+  std::size_t r = neg_;
+  for (Limb x : mag_)
+    r = r * 31 + h(x);
+  return r;
+}
+
+
+// Returns the decimal representation of the integer.
+String
+Integer::str() const
+{
+  if (is_word())
+    return std::to_string(word_);
+
+  // Extract 9 digits at a time, from least to most
+  // significant.
+  std::vector<Limb> chunks;
+  Limb_seq a = mag_;
+  while (!a.empty()) {
+    Limb k;
+    a = div_limb(a, 1000000000, k);
+    chunks.push_back(k);
+  }
+  String s = neg_ ? "-" : "";
+  s += std::to_string(chunks.back());
+  for (std::size_t i = chunks.size() - 1; i-- > 0;) {
+    String d = std::to_string(chunks[i]);
+    s += String(9 - d.size(), '0') + d;
+  }
+  return s;
+}
+
+
+Integer
+operator-(Integer const& a)
+{
+  if (a.is_word() && a.word_ != std::numeric_limits<Integer::Word>::min())
+    return -a.word_;
+  bool neg;
+  Limb_seq x;
+  a.split(neg, x);
+  return Integer(!neg && !x.empty(), std::move(x));
+}
+
+
+Integer
+operator+(Integer const& a, Integer const& b)
+{
+  Integer::Word r;
+  if (a.is_word() && b.is_word() && !__builtin_add_overflow(a.word_, b.word_, &r))
+    return r;
+
+  bool an, bn;
+  Limb_seq x, y;
+  a.split(an, x);
+  b.split(bn, y);
+  if (an == bn)
+    return Integer(an, add_mag(x, y));
+  if (compare_mag(x, y) >= 0)
+    return Integer(an, sub_mag(x, y));
+  else
+    return Integer(bn, sub_mag(y, x));
+}
+
+
+Integer
+operator-(Integer const& a, Integer const& b)
+{
+  Integer::Word r;
+  if (a.is_word() && b.is_word() && !__builtin_sub_overflow(a.word_, b.word_, &r))
+    return r;
+  return a + -b;
+}
+
+
+Integer
+operator*(Integer const& a, Integer const& b)
+{
+  Integer::Word r;
+  if (a.is_word() && b.is_word() && !__builtin_mul_overflow(a.word_, b.word_, &r))
+    return r;
+
+  bool an, bn;
+  Limb_seq x, y;
+  a.split(an, x);
+  b.split(bn, y);
+  return Integer(an != bn, mul_mag(x, y));
+}
+
+
+// Compute the quotient and remainder of a and b. The
+// quotient is truncated toward 0, and the remainder
+// has the sign of the dividend. Either result may be
+// omitted.
+void
+Integer::divide(Integer const& a, Integer const& b, Integer* q, Integer* r)
+{
+  if (b.sign() == 0)
+    throw std::runtime_error("division by 0");
+
+  // The quotient of the least word and -1 is not a word.
+  Word min = std::numeric_limits<Word>::min();
+  if (a.is_word() && b.is_word() && !(a.word_ == min && b.word_ == -1)) {
+    if (q)
+      *q = a.word_ / b.word_;
+    if (r)
+      *r = a.word_ % b.word_;
+    return;
+  }
+
+  bool an, bn;
+  Limb_seq x, y, qm, rm;
+  a.split(an, x);
+  b.split(bn, y);
+  divide_mag(x, y, qm, rm);
+  if (q)
+    *q = Integer(an != bn, std::move(qm));
+  if (r)
+    *r = Integer(an, std::move(rm));
+}
+
+
+Integer
+operator/(Integer const& a, Integer const& b)
+{
+  Integer q;
+  Integer::divide(a, b, &q, nullptr);
+  return q;
+}
+
+
+Integer
+operator%(Integer const& a, Integer const& b)
+{
+  Integer r;
+  Integer::divide(a, b, nullptr, &r);
+  return r;
+}
+
+
+// Because the representation is canonical, integers
+// are equal when their representations are.
+bool
+operator==(Integer const& a, Integer const& b)
+{
+  if (a.is_word() != b.is_word())
+    return false;
+  if (a.is_word())
+    return a.word_ == b.word_;
+  return a.neg_ == b.neg_ && a.mag_ == b.mag_;
+}
+
+
+// Returns a negative value, 0, or a positive value
+// when a is less than, equal to, or greater than b.
+int
+compare(Integer const& a, Integer const& b)
+{
+  if (a.is_word() && b.is_word())
+    return (a.word_ > b.word_) - (a.word_ < b.word_);
+  int as = a.sign();
+  int bs = b.sign();
+  if (as != bs)
+    return as < bs ? -1 : 1;
+
+  // Both have the same sign, and at least one is not
+  // a word, so its magnitude is greater.
+  if (a.is_word())
+    return -bs;
+  if (b.is_word())
+    return as;
+  int c = compare_mag(a.mag_, b.mag_);
+  return as < 0 ? -c : c;
+}
+
+
+std::ostream&
+operator<<(std::ostream& os, Integer const& n)
+{
+  if (n.is_word())
+    return os << n.word();
+  return os << n.str();
+}
@@ -0,0 +1,90 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef BEAKER_INTEGER_HPP
+#define BEAKER_INTEGER_HPP
+
+// The integer module defines arbitrary precision
+// integers. These are used to represent the values of
+// integer literals and, when arithmetic is exact, the
+// results of integer operations.
+
+#include "string.hpp"
+
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+
+// An arbitrary precision integer.
+//
+// An integer that fits in a 64-bit word is stored
+// inline. Larger integers are stored as a sign and a
+// magnitude: a sequence of 32-bit limbs, ordered from
+// least to most significant. Only those integers
+// allocate memory. The representation is canonical:
+// an integer has limbs only when it does not fit in
+// a word, and its most significant limb is not 0.
+class Integer
+{
+public:
+  using Word = std::int64_t;
+  using Limb = std::uint32_t;
+  using Limb_seq = std::vector<Limb>;
+
+  Integer(Word n = 0)
+    : word_(n), neg_(false)
+  { }
+
+  explicit Integer(String const&);
+
+  bool is_word() const { return mag_.empty(); }
+  Word word() const    { return word_; }
+  Word wrap() const;
+
+  int         sign() const;
+  std::size_t hash() const;
+  String      str() const;
+
+  friend Integer operator-(Integer const&);
+  friend Integer operator+(Integer const&, Integer const&);
+  friend Integer operator-(Integer const&, Integer const&);
+  friend Integer operator*(Integer const&, Integer const&);
+  friend Integer operator/(Integer const&, Integer const&);
+  friend Integer operator%(Integer const&, Integer const&);
+
+  friend bool operator==(Integer const&, Integer const&);
+  friend int  compare(Integer const&, Integer const&);
+
+private:
+  Integer(bool, Limb_seq&&);
+
+  void split(bool&, Limb_seq&) const;
+
+  static void divide(Integer const&, Integer const&, Integer*, Integer*);
+
+  Word     word_; // The value, when it fits in a word
+  bool     neg_;  // The sign of the magnitude
+  Limb_seq mag_;  // The magnitude, when it does not
+};
+
+
+inline bool
+operator!=(Integer const& a, Integer const& b)
+{
+  return !(a == b);
+}
+
+
+inline bool
+operator<(Integer const& a, Integer const& b)
+{
+  return compare(a, b) < 0;
+}
+
+
+// Streaming
+std::ostream& operator<<(std::ostream&, Integer const&);
+
+
+#endif
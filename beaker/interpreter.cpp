@@ -4,12 +4,17 @@
 #include "lexer.hpp"
 #include "parser.hpp"
 #include "elaborator.hpp"
-#include "evaluator.hpp"
+#include "fold.hpp"
+#include "decl.hpp"
+#include "instance.hpp"
+#include "machine.hpp"
 #include "generator.hpp"
 #include "error.hpp"
 
+#include <cstdlib>
 #include <iostream>
 #include <fstream>
+#include <memory>
 
 #include <llvm/IR/Module.h>
 #include <llvm/Support/raw_ostream.h>
@@ -25,8 +30,101 @@ main(int argc, char* argv[])
   Symbol_table syms;
   init_symbols(syms);
 
+  // Parse command line options. The input file is the
+  // first argument that is not an option.
+  //
+  //    --vm     Execute by way of the bytecode machine
+  //             instead of the tree walking evaluator.
+  //    --stats  Report call stack statistics of the
+  //             evaluator.
+  //    --jit    Compile hot functions to native code.
+  //    --jit=N  As above, where a function is hot after
+  //             N calls and loop iterations.
+  //    --memo   Cache the results of calls to pure
+  //             functions.
+  //    --memo=N As above, with a cache of N entries.
+  //    --max-depth=N
+  //             Limit the depth of calls in the evaluator
+  //             or bytecode machine to N.
+  //    --profile
+  //             Report the execution count and time of
+  //             every function and statement.
+  //    --profile=F
+  //             As above, and write the profile to the
+  //             file F as tab-separated values.
+  //    --unchecked
+  //             Integer arithmetic wraps on overflow
+  //             instead of failing.
+  //    --exact  Integer arithmetic is exact: results
+  //             that overflow a word are computed with
+  //             arbitrary precision.
+  bool use_vm = false;
+  bool show_stats = false;
+  int jit_threshold = 0;
+  int memo_size = 0;
+  int max_depth = Call_stack::default_depth;
+  bool use_profile = false;
+  Arithmetic arith = checked_arithmetic;
+  char const* profile_output = nullptr;
+  char const* input = nullptr;
+  for (int i = 1; i < argc; ++i) {
+    String arg = argv[i];
+    if (arg == "--vm") {
+      use_vm = true;
+    } else if (arg == "--jit") {
+      jit_threshold = 1000;
+    } else if (arg.compare(0, 6, "--jit=") == 0) {
+      jit_threshold = std::atoi(arg.c_str() + 6);
+      if (jit_threshold <= 0) {
+        std::cerr << "error: invalid threshold '" << arg << "'\n";
+        return -1;
+      }
+    } else if (arg == "--memo") {
+      memo_size = 1 << 16;
+    } else if (arg.compare(0, 7, "--memo=") == 0) {
+      memo_size = std::atoi(arg.c_str() + 7);
+      if (memo_size <= 0) {
+        std::cerr << "error: invalid cache size '" << arg << "'\n";
+        return -1;
+      }
+    } else if (arg.compare(0, 12, "--max-depth=") == 0) {
+      max_depth = std::atoi(arg.c_str() + 12);
+      if (max_depth <= 0) {
+        std::cerr << "error: invalid depth '" << arg << "'\n";
+        return -1;
+      }
+    } else if (arg == "--profile") {
+      use_profile = true;
+    } else if (arg.compare(0, 10, "--profile=") == 0) {
+      use_profile = true;
+      profile_output = argv[i] + 10;
+    } else if (arg == "--unchecked") {
+      arith = wrapping_arithmetic;
+    } else if (arg == "--exact") {
+      arith = exact_arithmetic;
+    } else if (arg == "--stats") {
+      show_stats = true;
+    } else if (arg[0] == '-') {
+      std::cerr << "error: unknown option '" << arg << "'\n";
+      return -1;
+    } else {
+      input = argv[i];
+    }
+  }
+  if (!input) {
+    std::cerr << "usage: beaker-interpret [--vm] [--jit[=N]] [--memo[=N]]\n"
+              << "                        [--max-depth=N] [--profile[=F]]\n"
+              << "                        [--unchecked | --exact] [--stats]\n"
+              << "                        input.bkr\n";
+    return -1;
+  }
+  if (use_vm && use_profile) {
+    std::cerr << "error: --profile requires the evaluator\n";
+    return -1;
+  }
+
   // Prepare the input buffer.
-  File src = argv[1];
+  File src = input;
   Input_buffer in = src;
 
   try {
@@ -54,6 +152,12 @@ main(int argc, char* argv[])
     Elaborator elab(locs);
     elab.elaborate(m);
 
+    // Replace constant expressions with literals.
+    Folder folder(syms);
+    folder.fold(m);
+    if (show_stats)
+      std::cerr << "fold: " << folder.folded() << " expressions folded\n";
+
     // Find an entry point for evaluation.
     //
     // TODO: The resolution of main is a little artificial.
@@ -61,10 +165,58 @@ main(int argc, char* argv[])
     // are evaluated prior to entering main.
     //
     // TODO: Actually pass command line arguments to main.
-    if (elab.main) {
-      Evaluator ev;
-      Value v = ev.exec(elab.main);
+    if (elab.main && use_vm) {
+      Program prog = assemble(cast<Module_decl>(m));
+      Machine vm(prog);
+      vm.arithmetic(arith);
+      vm.depth_limit(max_depth);
+      Value v = vm.exec(elab.main);
       std::cout << v << '\n';
+    } else if (elab.main) {
+      std::unique_ptr<Jit> jit;
+      if (jit_threshold)
+        jit.reset(new Jit(jit_threshold, arith));
+      std::unique_ptr<Memo_table> memo;
+      if (memo_size)
+        memo.reset(new Memo_table(memo_size));
+      std::unique_ptr<Profiler> prof;
+      if (use_profile)
+        prof.reset(new Profiler());
+      Module_instance inst(cast<Module_decl>(m), 1 << 20,
+                           jit.get(), memo.get(), prof.get(), arith);
+      Evaluator& ev = inst.evaluator();
+      ev.call_stack().depth_limit(max_depth);
+      Value v = inst.call(elab.main);
+      std::cout << v << '\n';
+
+      if (prof) {
+        prof->report(std::cerr, locs);
+        if (profile_output) {
+          std::ofstream f(profile_output);
+          prof->dump(f, locs);
+          if (!f) {
+            std::cerr << "error: cannot write '" << profile_output << "'\n";
+            return -1;
+          }
+        }
+      }
+
+      if (show_stats && jit)
+        std::cerr << "jit: " << jit->compiled() << " functions compiled\n";
+      if (show_stats && memo)
+        std::cerr << "memo: " << memo->hits() << " hits, "
+                  << memo->misses() << " misses, "
+                  << memo->evictions() << " evictions, "
+                  << memo->size() << " of " << memo->capacity()
+                  << " entries\n";
+      if (show_stats) {
+        Call_stack const& cs = ev.call_stack();
+        std::cerr << "call stack: max depth " << cs.max_depth()
+                  << ", high-water " << cs.high_water()
+                  << " of " << cs.capacity() << " values ("
+                  << cs.high_water() * sizeof(Value) << " bytes)\n";
+        std::cerr << "tail calls: " << ev.tail_calls() << '\n';
+      }
     } else {
       std::cout << "no main\n";
     }
@@ -0,0 +1,522 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "jit.hpp"
+#include "generator.hpp"
+#include "type.hpp"
+#include "expr.hpp"
+#include "stmt.hpp"
+#include "decl.hpp"
+
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Transforms/Scalar.h>
+#include <llvm/Transforms/Utils.h>
+#include <llvm/Transforms/Utils/BasicBlockUtils.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+
+namespace
+{
+
+// -------------------------------------------------------------------------- //
+// Eligibility
+
+// Returns true if values of type t can be passed to
+// and returned from native code.
+inline bool
+is_scalar(Type const* t)
+{
+  return is<Integer_type>(t) || is<Boolean_type>(t);
+}
+
+
+// The scan determines whether the body of a function
+// can be compiled, and collects the functions that
+// it calls.
+struct Scan
+{
+  bool check(Expr const*);
+  bool check(Stmt const*);
+  bool check(Decl const*);
+
+  std::vector<Function_decl const*> callees;
+  int                               loops = 0;
+};
+
+
+// Divisors shall be non-zero literals.
+bool
+Scan::check(Expr const* e)
+{
+  struct Fn
+  {
+    Scan& s;
+
+    // Integer literals shall fit in a word.
+    bool operator()(Literal_expr const* e)
+    {
+      Integer_sym const* z = as<Integer_sym>(e->symbol());
+      return !z || z->value().is_word();
+    }
+
+    // Only parameters and local variables can be
+    // referenced. Function names are handled by calls.
+    bool operator()(Id_expr const* e)
+    {
+      Decl const* d = e->declaration();
+      if (is<Parameter_decl>(d))
+        return true;
+      if (Variable_decl const* v = as<Variable_decl>(d))
+        return !is_global_variable(v);
+      return false;
+    }
+
+    bool operator()(Unary_expr const* e) { return s.check(e->operand()); }
+
+    bool operator()(Binary_expr const* e)
+    {
+      return s.check(e->left()) && s.check(e->right());
+    }
+
+    bool operator()(Div_expr const* e) { return divide(e); }
+    bool operator()(Rem_expr const* e) { return divide(e); }
+
+    bool operator()(Call_expr const* e)
+    {
+      Id_expr const* id = as<Id_expr>(e->target());
+      if (!id || !is<Function_decl>(id->declaration()))
+        return false;
+      for (Expr const* a : e->arguments())
+        if (!s.check(a))
+          return false;
+      s.callees.push_back(cast<Function_decl>(id->declaration()));
+      return true;
+    }
+
+    // Aggregates have no native representation.
+    bool operator()(Member_expr const* e) { return false; }
+    bool operator()(Index_expr const* e) { return false; }
+
+    bool operator()(Value_conv const* e) { return s.check(e->source()); }
+
+    bool operator()(Default_init const* e) { return is_scalar(e->type()); }
+
+    bool operator()(Copy_init const* e)
+    {
+      return is_scalar(e->type()) && s.check(e->value());
+    }
+
+    bool divide(Binary_expr const* e)
+    {
+      Literal_expr const* lit = as<Literal_expr>(e->right());
+      if (!lit)
+        return false;
+      Integer_sym const* z = as<Integer_sym>(lit->symbol());
+      return z && z->value() != 0 && s.check(e->left());
+    }
+  };
+
+  return apply(e, Fn{*this});
+}
+
+
+// Break and continue shall appear within a loop.
+bool
+Scan::check(Stmt const* s)
+{
+  struct Fn
+  {
+    Scan& s;
+
+    bool operator()(Empty_stmt const*) { return true; }
+
+    bool operator()(Block_stmt const* b)
+    {
+      for (Stmt const* s1 : b->statements())
+        if (!s.check(s1))
+          return false;
+      return true;
+    }
+
+    bool operator()(Assign_stmt const* a)
+    {
+      return s.check(a->object()) && s.check(a->value());
+    }
+
+    bool operator()(Return_stmt const* r) { return s.check(r->value()); }
+
+    bool operator()(If_then_stmt const* i)
+    {
+      return s.check(i->condition()) && s.check(i->body());
+    }
+
+    bool operator()(If_else_stmt const* i)
+    {
+      return s.check(i->condition())
+          && s.check(i->true_branch())
+          && s.check(i->false_branch());
+    }
+
+    bool operator()(While_stmt const* w)
+    {
+      ++s.loops;
+      bool ok = s.check(w->condition()) && s.check(w->body());
+      --s.loops;
+      return ok;
+    }
+
+    bool operator()(Break_stmt const*) { return s.loops > 0; }
+    bool operator()(Continue_stmt const*) { return s.loops > 0; }
+
+    bool operator()(Expression_stmt const* e)
+    {
+      return s.check(e->expression());
+    }
+
+    bool operator()(Declaration_stmt const* d)
+    {
+      return s.check(d->declaration());
+    }
+  };
+
+  return apply(s, Fn{*this});
+}
+
+
+// Only scalar local variables can be declared within
+// a compiled function.
+bool
+Scan::check(Decl const* d)
+{
+  Variable_decl const* v = as<Variable_decl>(d);
+  return v && is_scalar(v->type()) && check(v->init());
+}
+
+
+// Returns true if every path through s ends in a return.
+// Loops are never assumed to return.
+bool
+returns(Stmt const* s)
+{
+  if (is<Return_stmt>(s))
+    return true;
+  if (Block_stmt const* b = as<Block_stmt>(s)) {
+    Stmt_seq const& ss = b->statements();
+    return std::any_of(ss.begin(), ss.end(), returns);
+  }
+  if (If_else_stmt const* i = as<If_else_stmt>(s))
+    return returns(i->true_branch()) && returns(i->false_branch());
+  return false;
+}
+
+
+// -------------------------------------------------------------------------- //
+// Native entry points
+
+// The trap function of compiled code. Only overflow
+// can trap, since divisors are non-zero literals.
+//
+// Note that the exception propagates through native
+// frames, whose unwind tables are registered by the JIT.
+void
+overflow()
+{
+  throw std::runtime_error("integer overflow");
+}
+
+
+// The trap function of recursive calls that nest deeper
+// than the evaluator allows.
+void
+too_deep()
+{
+  throw std::runtime_error("maximum call depth exceeded");
+}
+
+
+// Generate the native entry point of f, which unpacks
+// its arguments, sets the depth d, calls f, and stores
+// the widened result.
+void
+entry(llvm::Module& mod, llvm::Function* f, llvm::GlobalVariable* d,
+      String const& name)
+{
+  llvm::LLVMContext& cxt = mod.getContext();
+  llvm::IRBuilder<> build(cxt);
+  llvm::Type* word = build.getInt64Ty();
+  llvm::Type* ptr = word->getPointerTo();
+  llvm::FunctionType* type =
+    llvm::FunctionType::get(build.getVoidTy(), {ptr, ptr, word}, false);
+  llvm::Function* fn = llvm::Function::Create(
+    type, llvm::Function::ExternalLinkage, name, &mod);
+
+  build.SetInsertPoint(llvm::BasicBlock::Create(cxt, "entry", fn));
+  build.CreateStore(fn->getArg(2), d);
+  llvm::Value* args = fn->getArg(0);
+  std::vector<llvm::Value*> vs;
+  for (unsigned i = 0; i < f->arg_size(); ++i) {
+    llvm::Value* p = build.CreateConstGEP1_32(word, args, i);
+    llvm::Value* v = build.CreateLoad(word, p);
+    vs.push_back(build.CreateTrunc(v, f->getArg(i)->getType()));
+  }
+  llvm::Value* r = build.CreateCall(f, vs);
+
+  // Booleans are widened to 0 or 1, integers by
+  // sign extension.
+  if (r->getType()->isIntegerTy(1))
+    r = build.CreateZExt(r, word);
+  else
+    r = build.CreateSExt(r, word);
+  build.CreateStore(r, fn->getArg(1));
+  build.CreateRetVoid();
+}
+
+
+// Returns true if f calls itself.
+bool
+recursive(llvm::Function& f)
+{
+  for (llvm::User* u : f.users())
+    if (llvm::CallBase* c = llvm::dyn_cast<llvm::CallBase>(u))
+      if (c->getFunction() == &f)
+        return true;
+  return false;
+}
+
+
+// Count each call to f against the depth d, which is the
+// number of calls that may still nest. When d is 0, the
+// call traps instead. The depth is restored on return.
+void
+limit_depth(llvm::Function& f, llvm::GlobalVariable* d, llvm::FunctionCallee trap)
+{
+  std::vector<llvm::ReturnInst*> rets;
+  for (llvm::BasicBlock& b : f)
+    if (llvm::ReturnInst* r = llvm::dyn_cast<llvm::ReturnInst>(b.getTerminator()))
+      rets.push_back(r);
+
+  llvm::Instruction* first = &*f.getEntryBlock().getFirstInsertionPt();
+  llvm::IRBuilder<> build(first);
+  llvm::Type* word = build.getInt64Ty();
+  llvm::Value* n = build.CreateLoad(word, d);
+  llvm::Value* z = build.CreateICmpEQ(n, build.getInt64(0));
+  llvm::Instruction* t = llvm::SplitBlockAndInsertIfThen(z, first, true);
+  build.SetInsertPoint(t);
+  build.CreateCall(trap);
+  build.SetInsertPoint(first);
+  build.CreateStore(build.CreateSub(n, build.getInt64(1)), d);
+  for (llvm::ReturnInst* r : rets) {
+    build.SetInsertPoint(r);
+    build.CreateStore(n, d);
+  }
+}
+
+} // namespace
+
+
+// -------------------------------------------------------------------------- //
+// JIT
+
+// Create the ORC JIT for the host. Native code uses the
+// arithmetic mode m.
+Jit::Jit(int n, Arithmetic m)
+  : arith(m), threshold_(n), compiled_(0)
+{
+  llvm::InitializeNativeTarget();
+  llvm::InitializeNativeTargetAsmPrinter();
+
+  auto j = llvm::orc::LLJITBuilder().create();
+  if (!j)
+    throw std::runtime_error(llvm::toString(j.takeError()));
+  jit = std::move(*j);
+
+  // Make the trap functions visible to native code.
+  llvm::orc::SymbolMap syms;
+  syms[jit->mangleAndIntern("__beaker_overflow")] = llvm::JITEvaluatedSymbol(
+    llvm::pointerToJITTargetAddress(&overflow),
+    llvm::JITSymbolFlags::Exported);
+  syms[jit->mangleAndIntern("__beaker_too_deep")] = llvm::JITEvaluatedSymbol(
+    llvm::pointerToJITTargetAddress(&too_deep),
+    llvm::JITSymbolFlags::Exported);
+  if (llvm::Error err = jit->getMainJITDylib().define(
+        llvm::orc::absoluteSymbols(std::move(syms))))
+    throw std::runtime_error(llvm::toString(std::move(err)));
+}
+
+
+Jit::~Jit()
+{ }
+
+
+// Returns true if f can be compiled. The result is
+// cached. Note that a recursive call to f is assumed
+// to be compilable while f is being checked. Because
+// functions must be declared before they are used,
+// this only happens for direct recursion.
+bool
+Jit::eligible(Function_decl const* f)
+{
+  Entry& e = fns[f];
+  if (e.status != unchecked)
+    return e.status != rejected;
+
+  e.status = checking;
+  bool ok = is_scalar(f->return_type())
+         && f->parameters().size() <= std::size_t(max_args)
+         && returns(f->body());
+  for (Decl const* p : f->parameters())
+    ok = ok && is_scalar(p->type());
+
+  Scan s;
+  ok = ok && s.check(f->body());
+  for (Function_decl const* g : s.callees)
+    ok = ok && eligible(g);
+
+  // Note that e is still valid: references to the
+  // elements of an unordered map are stable.
+  e.status = ok ? compilable : rejected;
+  if (ok) {
+    std::sort(s.callees.begin(), s.callees.end());
+    s.callees.erase(std::unique(s.callees.begin(), s.callees.end()),
+                    s.callees.end());
+    e.callees = std::move(s.callees);
+  }
+  return ok;
+}
+
+
+// Collect f and the functions it calls, transitively,
+// such that every function follows its callees. The
+// only cycles in the call graph are direct recursion.
+void
+Jit::closure(Function_decl const* f, std::vector<Function_decl const*>& fs)
+{
+  if (std::find(fs.begin(), fs.end(), f) != fs.end())
+    return;
+  for (Function_decl const* g : fns[f].callees)
+    if (g != f)
+      closure(g, fs);
+  fs.push_back(f);
+}
+
+
+// Compile f and all of the functions that it calls into
+// a new module. Every function in the module has internal
+// linkage, so each compilation is independent of all
+// others; only the entry point of f is visible. If f
+// cannot be compiled, it is marked for interpretation.
+Native_fn
+Jit::compile(Function_decl const* f)
+{
+  if (!eligible(f))
+    return nullptr;
+  Entry& e = fns[f];
+
+  std::vector<Function_decl const*> fs;
+  closure(f, fs);
+
+  std::unique_ptr<llvm::LLVMContext> cxt(new llvm::LLVMContext());
+  Generator gen(*cxt);
+  gen.arith = arith == exact_arithmetic ? checked_arithmetic : arith;
+  gen.trap_fn = "__beaker_overflow";
+  gen.trap_unwinds = true;
+  std::unique_ptr<llvm::Module> mod;
+  try {
+    mod.reset(gen(fs));
+  } catch (std::exception&) {
+    delete gen.mod;
+    e.status = rejected;
+    return nullptr;
+  }
+
+  // Generate the entry point and make everything
+  // else private to the module.
+  llvm::Function* fn = mod->getFunction(f->name()->spelling());
+  String name = "__beaker_native_" + std::to_string(compiled_);
+  for (llvm::Function& g : *mod)
+    if (!g.isDeclaration())
+      g.setLinkage(llvm::Function::InternalLinkage);
+  llvm::Type* word = llvm::Type::getInt64Ty(*cxt);
+  llvm::GlobalVariable* depth = new llvm::GlobalVariable(
+    *mod, word, false, llvm::GlobalValue::InternalLinkage,
+    llvm::ConstantInt::get(word, 0), "__beaker_depth");
+  entry(*mod, fn, depth, name);
+
+  // The generator can produce ill-formed IR for some
+  // programs (e.g., statements following a return).
+  if (llvm::verifyModule(*mod)) {
+    e.status = rejected;
+    return nullptr;
+  }
+
+  // Promote locals to registers before compiling, and
+  // turn tail recursion into loops so that native code
+  // runs in constant stack where the evaluator does.
+  llvm::legacy::FunctionPassManager fpm(mod.get());
+  fpm.add(llvm::createPromoteMemoryToRegisterPass());
+  fpm.add(llvm::createCFGSimplificationPass());
+  fpm.add(llvm::createTailCallEliminationPass());
+  fpm.doInitialization();
+  for (llvm::Function& g : *mod)
+    fpm.run(g);
+  fpm.doFinalization();
+
+  // Calls that remain recursive nest on the native stack,
+  // so they count against the depth limit of the evaluator
+  // and fail as it does. Counting reads and writes memory
+  // and may throw, so the attributes that say otherwise
+  // are dropped from every function that might reach it.
+  // Only direct recursion is counted: the other calls nest
+  // no deeper than the number of functions.
+  std::vector<llvm::Function*> rec;
+  for (llvm::Function& g : *mod)
+    if (!g.isDeclaration() && recursive(g))
+      rec.push_back(&g);
+  if (!rec.empty()) {
+    llvm::FunctionType* t =
+      llvm::FunctionType::get(llvm::Type::getVoidTy(*cxt), false);
+    llvm::AttributeList a = llvm::AttributeList::get(
+      *cxt, llvm::AttributeList::FunctionIndex,
+      {llvm::Attribute::NoReturn, llvm::Attribute::Cold});
+    llvm::FunctionCallee trap = mod->getOrInsertFunction("__beaker_too_deep", t, a);
+    for (llvm::Function* g : rec)
+      limit_depth(*g, depth, trap);
+    for (llvm::Function& g : *mod) {
+      if (g.isDeclaration())
+        continue;
+      g.removeFnAttr(llvm::Attribute::ReadNone);
+      g.removeFnAttr(llvm::Attribute::ReadOnly);
+      g.removeFnAttr(llvm::Attribute::NoUnwind);
+      for (llvm::BasicBlock& b : g)
+        for (llvm::Instruction& i : b)
+          if (llvm::CallBase* c = llvm::dyn_cast<llvm::CallBase>(&i)) {
+            c->removeFnAttr(llvm::Attribute::ReadNone);
+            c->removeFnAttr(llvm::Attribute::ReadOnly);
+            c->removeFnAttr(llvm::Attribute::NoUnwind);
+          }
+    }
+  }
+
+  llvm::orc::ThreadSafeModule tsm(std::move(mod), std::move(cxt));
+  if (llvm::Error err = jit->addIRModule(std::move(tsm))) {
+    llvm::consumeError(std::move(err));
+    e.status = rejected;
+    return nullptr;
+  }
+  auto sym = jit->lookup(name);
+  if (!sym) {
+    llvm::consumeError(sym.takeError());
+    e.status = rejected;
+    return nullptr;
+  }
+
+  ++compiled_;
+  return reinterpret_cast<Native_fn>(sym->getAddress());
+}
@@ -0,0 +1,139 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef BEAKER_JIT_HPP
+#define BEAKER_JIT_HPP
+
+// The JIT provides a second execution tier for the
+// evaluator. Functions that are called often, or that
+// spend many iterations in loops, are compiled to native
+// code by way of the LLVM IR generator and an in-process
+// ORC JIT. Subsequent calls to those functions execute
+// natively. The evaluator remains the reference for the
+// semantics of the language: a function is only compiled
+// when its native code is known to produce the same
+// result as its interpretation, and every other function
+// stays in the interpreter.
+
+#include "prelude.hpp"
+#include "value.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+
+namespace llvm
+{
+namespace orc
+{
+class LLJIT;
+} // namespace orc
+} // namespace llvm
+
+
+// The entry point of a compiled function. Arguments are
+// read from the first array and the result is written
+// to the second. Every value is passed as a 64-bit
+// integer, regardless of its type. The last argument is
+// the number of recursive calls that may nest within the
+// function.
+using Native_fn = void (*)(std::int64_t const*, std::int64_t*, std::int64_t);
+
+
+// The JIT counts the calls to, and loop iterations
+// within, each function. When that count reaches the
+// threshold, the function is compiled together with
+// every function it calls.
+//
+// A function can be compiled only if:
+//
+//    - its parameters and result are integers or booleans,
+//    - it does not refer to global variables,
+//    - it only calls functions by name, and those
+//      functions can also be compiled,
+//    - it does not divide by a value that might be 0, and
+//    - every path through its body returns a value.
+//
+// These restrictions guarantee that native code cannot
+// observe or modify the state of the evaluator, and that
+// it fails in exactly the same places as the evaluator.
+// Native code uses the same arithmetic mode as the
+// evaluator. When arithmetic is checked, an overflow in
+// native code throws the same error as the evaluator.
+// When arithmetic is exact, native code is checked, and
+// the evaluator interprets calls that overflow. Recursive
+// calls in native code count against the depth limit of
+// the evaluator, and fail with the same error.
+class Jit
+{
+public:
+  static constexpr int max_args = 16;
+
+  Jit(int = 1000, Arithmetic = checked_arithmetic);
+  ~Jit();
+
+  Native_fn call(Function_decl const*);
+  void      loop(Function_decl const*);
+
+  // Statistics
+  int threshold() const { return threshold_; }
+  Arithmetic arithmetic() const { return arith; }
+  int compiled() const  { return compiled_; }
+
+private:
+  enum Status
+  {
+    unchecked,  // Not yet analyzed
+    checking,   // Under analysis
+    compilable, // Can be compiled
+    rejected,   // Must be interpreted
+  };
+
+  struct Entry
+  {
+    int                               count = 0;
+    Native_fn                         code = nullptr;
+    Status                            status = unchecked;
+    std::vector<Function_decl const*> callees;
+  };
+
+  bool      eligible(Function_decl const*);
+  void      closure(Function_decl const*, std::vector<Function_decl const*>&);
+  Native_fn compile(Function_decl const*);
+
+  std::unique_ptr<llvm::orc::LLJIT>                jit;
+  std::unordered_map<Function_decl const*, Entry> fns;
+  Arithmetic                                      arith;
+  int                                             threshold_;
+  int                                             compiled_;
+};
+
+
+// Record a call to f. Returns the native code for f if
+// it has been compiled, and nullptr otherwise. If this
+// call makes f hot, f is compiled first.
+inline Native_fn
+Jit::call(Function_decl const* f)
+{
+  Entry& e = fns[f];
+  if (e.code || e.status == rejected)
+    return e.code;
+  if (++e.count < threshold_)
+    return nullptr;
+  return e.code = compile(f);
+}
+
+
+// Record an iteration of a loop in f. The function is
+// compiled on its next call, since the current call
+// cannot be transferred to native code.
+inline void
+Jit::loop(Function_decl const* f)
+{
+  ++fns[f].count;
+}
+
+
+#endif
@@ -55,6 +55,17 @@ is_less(Record_type const* a, Record_type const* b)
 }
 
 
+inline bool
+is_less(Array_type const* a, Array_type const* b)
+{
+  if (is_less(a->first, b->first))
+    return true;
+  if (is_less(b->first, a->first))
+    return false;
+  return a->second < b->second;
+}
+
+
 bool
 is_less(Type const* a, Type const* b)
 {
@@ -68,6 +79,7 @@ is_less(Type const* a, Type const* b)
     bool operator()(Function_type const* a) { return is_less(a, cast<Function_type>(b)); }
     bool operator()(Reference_type const* a) { return is_less(a, cast<Reference_type>(b)); }
     bool operator()(Record_type const* a) { return is_less(a, cast<Record_type>(b)); }
+    bool operator()(Array_type const* a) { return is_less(a, cast<Array_type>(b)); }
   };
 
   std::type_index t1 = typeid(*a);
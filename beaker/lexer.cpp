@@ -63,7 +63,10 @@ Lexer::scan()
       case '}': return rbrace();
       case '(': return lparen();
       case ')': return rparen();
+      case '[': return lbracket();
+      case ']': return rbracket();
       case ',': return comma();
+      case '.': return dot();
       case ':': return colon();
       case ';': return semicolon();
       case '+': return plus();
@@ -144,8 +147,7 @@ inline Token
 Lexer::on_integer()
 {
   String str = build_.take();
-  int n = string_to_int<int>(str, 10);
-  Symbol* sym = syms_.put<Integer_sym>(str, integer_tok, n);
+  Symbol* sym = syms_.put<Integer_sym>(str, integer_tok, Integer(str));
   return Token(loc_, integer_tok, sym);
 }
 
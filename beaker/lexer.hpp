@@ -157,7 +157,10 @@ public:
   Token rbrace();
   Token lparen();
   Token rparen();
+  Token lbracket();
+  Token rbracket();
   Token comma();
+  Token dot();
   Token colon();
   Token semicolon();
   Token plus();
@@ -306,6 +309,20 @@ Lexer::rparen()
 }
 
 
+inline Token
+Lexer::lbracket()
+{
+  return symbol1();
+}
+
+
+inline Token
+Lexer::rbracket()
+{
+  return symbol1();
+}
+
+
 inline Token
 Lexer::comma()
 {
@@ -313,6 +330,13 @@ Lexer::comma()
 }
 
 
+inline Token
+Lexer::dot()
+{
+  return symbol1();
+}
+
+
 inline Token
 Lexer::colon()
 {
@@ -0,0 +1,312 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "machine.hpp"
+#include "evaluator.hpp"
+#include "decl.hpp"
+#include "error.hpp"
+
+#include <algorithm>
+
+
+Machine::Machine(Program const& p, std::size_t n)
+  : prog(p), stack(n), globals(p.globals), result(p.result),
+    heap([this](Box_heap& h) {
+      h.mark(stack.data(), stack.data() + stack.size());
+      h.mark(globals.data(), globals.data() + globals.size());
+      h.mark(result.data(), result.data() + result.size());
+    }),
+    arith(checked_arithmetic), limit_depth(Call_stack::default_depth)
+{
+  frames.reserve(256);
+}
+
+
+// Execute the given function. As with the evaluator,
+// the global initializers are run prior to entering
+// the function. Its frame is cleared on entry, so its
+// parameters, if any, are 0. The result is valid until
+// the next execution.
+Value
+Machine::exec(Function_decl const* fn)
+{
+  Box_heap::Scope scope(heap);
+  std::fill(globals.begin(), globals.end(), Value());
+  run(&prog.init);
+  return run(prog.code(fn));
+}
+
+
+// Run the given code to completion, returning the
+// result of the outermost call. As in the evaluator,
+// the entry counts as a call unless it initializes the
+// globals.
+Value
+Machine::run(Code const* entry)
+{
+  Value* const limit = stack.data() + stack.size();
+  std::size_t const outer = entry->fn ? 1 : 0;
+
+  Code const* code = entry;
+  Instruction const* pc = code->code.data();
+  Value* base = stack.data();
+  Value* sp = base + code->slots;
+  if (sp + code->depth > limit)
+    throw std::runtime_error("stack overflow");
+  std::fill(base, sp, Value());
+  frames.clear();
+
+  while (true) {
+    Instruction const& i = *pc++;
+    switch (i.op) {
+      case imm_op:
+        *sp++ = Value(i.arg);
+        break;
+
+      case lit_op:
+        *sp++ = make_integer(arith, prog.literals[i.arg]);
+        break;
+
+      case fn_op:
+        *sp++ = Value(prog.fns[i.arg].fn);
+        break;
+
+      case load_op:
+        *sp++ = base[i.arg];
+        break;
+
+      case store_op:
+        base[i.arg] = *--sp;
+        break;
+
+      case gload_op:
+        *sp++ = globals[i.arg];
+        break;
+
+      case gstore_op:
+        globals[i.arg] = *--sp;
+        break;
+
+      case addr_op:
+        *sp++ = Value(base + i.arg);
+        break;
+
+      case gaddr_op:
+        *sp++ = Value(globals.data() + i.arg);
+        break;
+
+      case field_op:
+        sp[-1] = Value(sp[-1].as_reference() + i.arg);
+        break;
+
+      case check_op: {
+        Value const& n = sp[-1];
+        if (!n.is_small() || std::uint64_t(n.as_integer()) >= std::uint64_t(i.arg))
+          throw std::runtime_error("array index out of bounds");
+        break;
+      }
+
+      case index_op:
+        --sp;
+        sp[-1] = Value(sp[-1].as_reference() + sp[0].as_integer() * i.arg);
+        break;
+
+      case deref_op:
+        sp[-1] = *sp[-1].as_reference();
+        break;
+
+      case assign_op:
+        sp -= 2;
+        *sp[0].as_reference() = sp[1];
+        break;
+
+      case copy_op:
+        --sp;
+        std::copy_n(sp[0].as_reference(), i.arg, sp[-1].as_reference());
+        break;
+
+      case zero_op:
+        std::fill_n(sp[-1].as_reference(), i.arg, Value());
+        break;
+
+      // The block cannot overlap the operand stack, since
+      // aggregates returned by calls are in the result block.
+      case spread_op: {
+        Value* p = sp[-1].as_reference();
+        sp = std::copy_n(p, i.arg, sp - 1);
+        break;
+      }
+
+      case pop_op:
+        --sp;
+        break;
+
+      case add_op:
+        --sp;
+        sp[-1] = integer_add(arith, sp[-1], sp[0]);
+        break;
+
+      case sub_op:
+        --sp;
+        sp[-1] = integer_sub(arith, sp[-1], sp[0]);
+        break;
+
+      case mul_op:
+        --sp;
+        sp[-1] = integer_mul(arith, sp[-1], sp[0]);
+        break;
+
+      case div_op:
+        --sp;
+        sp[-1] = integer_div(arith, sp[-1], sp[0]);
+        break;
+
+      case rem_op:
+        --sp;
+        sp[-1] = integer_rem(arith, sp[-1], sp[0]);
+        break;
+
+      case neg_op:
+        sp[-1] = integer_neg(arith, sp[-1]);
+        break;
+
+      case not_op:
+        sp[-1] = !sp[-1].as_integer();
+        break;
+
+      case eq_op:
+        --sp;
+        sp[-1] = equal(sp[-1], sp[0]);
+        break;
+
+      case ne_op:
+        --sp;
+        sp[-1] = !equal(sp[-1], sp[0]);
+        break;
+
+      case lt_op:
+        --sp;
+        sp[-1] = integer_less(sp[-1], sp[0]);
+        break;
+
+      case gt_op:
+        --sp;
+        sp[-1] = integer_less(sp[0], sp[-1]);
+        break;
+
+      case le_op:
+        --sp;
+        sp[-1] = !integer_less(sp[0], sp[-1]);
+        break;
+
+      case ge_op:
+        --sp;
+        sp[-1] = !integer_less(sp[-1], sp[0]);
+        break;
+
+      case jmp_op:
+        pc = code->code.data() + i.arg;
+        break;
+
+      case jf_op:
+        if (!(--sp)->as_integer())
+          pc = code->code.data() + i.arg;
+        break;
+
+      case and_op:
+        if (!sp[-1].as_integer())
+          pc = code->code.data() + i.arg;
+        else
+          --sp;
+        break;
+
+      case or_op:
+        if (sp[-1].as_integer())
+          pc = code->code.data() + i.arg;
+        else
+          --sp;
+        break;
+
+      // Push a new frame. The arguments of the call
+      // become the first slots of the callee's frame.
+      // When the call is indirect, the function value
+      // is discarded on return.
+      case call_op:
+      case icall_op: {
+        Code const* callee;
+        Value* top;
+        if (i.op == call_op) {
+          callee = &prog.fns[i.arg];
+          top = sp - callee->parms;
+        } else {
+          callee = prog.code(sp[-i.arg - 1].as_function());
+          top = sp - i.arg - 1;
+        }
+        if (frames.size() + outer == limit_depth)
+          throw std::runtime_error("maximum call depth exceeded");
+        frames.push_back({code, pc, base, top});
+
+        code = callee;
+        pc = code->code.data();
+        base = sp - code->parms;
+        sp = base + code->slots;
+        if (sp + code->depth > limit)
+          throw std::runtime_error("stack overflow");
+        std::fill(base + code->parms, sp, Value());
+        break;
+      }
+
+      // Replace the current frame. The arguments of the
+      // call are moved into the first slots of the frame.
+      case tcall_op:
+      case itcall_op: {
+        Value* args;
+        if (i.op == tcall_op) {
+          code = &prog.fns[i.arg];
+          args = sp - code->parms;
+        } else {
+          code = prog.code(sp[-i.arg - 1].as_function());
+          args = sp - i.arg;
+        }
+        std::copy(args, sp, base);
+
+        pc = code->code.data();
+        sp = base + code->slots;
+        if (sp + code->depth > limit)
+          throw std::runtime_error("stack overflow");
+        std::fill(base + code->parms, sp, Value());
+        break;
+      }
+
+      // Pop the current frame, leaving the result
+      // on the caller's operand stack. An aggregate
+      // result is first copied into the result block,
+      // since the caller's operands overwrite the frame.
+      // It is intact until the next aggregate return.
+      case ret_op:
+      case aret_op: {
+        Value r = sp[-1];
+        if (i.op == aret_op && r.as_reference() != result.data()) {
+          std::copy_n(r.as_reference(), i.arg, result.data());
+          r = Value(result.data());
+        }
+        if (frames.empty())
+          return r;
+        Frame const& f = frames.back();
+        code = f.code;
+        pc = f.pc;
+        base = f.base;
+        sp = f.top;
+        *sp++ = r;
+        frames.pop_back();
+        break;
+      }
+
+      case trap_op:
+        if (frames.empty())
+          throw std::runtime_error("function error");
+        else
+          throw std::runtime_error("function evaluation failed");
+    }
+  }
+}
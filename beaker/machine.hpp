@@ -0,0 +1,65 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef BEAKER_MACHINE_HPP
+#define BEAKER_MACHINE_HPP
+
+// The bytecode machine executes lowered programs.
+
+#include "prelude.hpp"
+#include "value.hpp"
+#include "bytecode.hpp"
+
+#include <vector>
+
+
+// The machine executes the code of a program in a
+// single dispatch loop. The operand stack holds the
+// frames of all active calls: the arguments and locals
+// of a call are followed by its operands. Calls and
+// returns do not recurse within the machine. As in the
+// evaluator, integer arithmetic is checked by default,
+// tail calls re-use the frame of the caller, and other
+// calls nest no deeper than the depth limit.
+// The roots of its heap are the operand stack, the
+// globals, and the result block.
+class Machine
+{
+public:
+  Machine(Program const&, std::size_t = 1 << 20);
+
+  Value exec(Function_decl const*);
+
+  Arithmetic arithmetic() const       { return arith; }
+  void       arithmetic(Arithmetic m) { arith = m; }
+
+  std::size_t depth_limit() const      { return limit_depth; }
+  void        depth_limit(std::size_t n) { limit_depth = n; }
+
+private:
+  struct Frame;
+
+  Value run(Code const*);
+
+  Program const&     prog;
+  std::vector<Value> stack;   // Frames and operands
+  std::vector<Value> globals; // Global variables
+  std::vector<Value> result;  // Returned aggregates
+  Box_heap           heap;    // Boxes of large integers
+  std::vector<Frame> frames;  // The call stack
+  Arithmetic         arith;   // Integer overflow behavior
+  std::size_t        limit_depth; // Maximum number of nested calls
+};
+
+
+// The saved state of a caller.
+struct Machine::Frame
+{
+  Code const*        code;
+  Instruction const* pc;
+  Value*             base;
+  Value*             top;   // The caller's stack on return
+};
+
+
+#endif
@@ -0,0 +1,113 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "optimizer.hpp"
+
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/PassTimingInfo.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <stdexcept>
+
+
+namespace
+{
+
+llvm::OptimizationLevel
+get_level(int n)
+{
+  switch (n) {
+    case 0: return llvm::OptimizationLevel::O0;
+    case 1: return llvm::OptimizationLevel::O1;
+    case 2: return llvm::OptimizationLevel::O2;
+    case 3: return llvm::OptimizationLevel::O3;
+  }
+  throw std::runtime_error("invalid optimization level");
+}
+
+} // namespace
+
+
+// Optimize the module m. When timing, the time taken
+// by each pass is written to the standard error stream
+// after the pipeline has run.
+void
+Optimizer::operator()(llvm::Module* m)
+{
+  llvm::PassInstrumentationCallbacks pic;
+  llvm::TimePassesHandler timer(timing);
+  timer.setOutStream(llvm::errs());
+  timer.registerCallbacks(pic);
+
+  llvm::PassBuilder pb(target, llvm::PipelineTuningOptions(), llvm::None, &pic);
+  llvm::LoopAnalysisManager lam;
+  llvm::FunctionAnalysisManager fam;
+  llvm::CGSCCAnalysisManager cgam;
+  llvm::ModuleAnalysisManager mam;
+  pb.registerModuleAnalyses(mam);
+  pb.registerCGSCCAnalyses(cgam);
+  pb.registerFunctionAnalyses(fam);
+  pb.registerLoopAnalyses(lam);
+  pb.crossRegisterProxies(lam, fam, cgam, mam);
+
+  llvm::OptimizationLevel l = get_level(level);
+  llvm::ModulePassManager mpm;
+  if (level == 0)
+    mpm = pb.buildO0DefaultPipeline(l);
+  else
+    mpm = pb.buildPerModuleDefaultPipeline(l);
+  mpm.run(*m, mam);
+
+  if (timing)
+    timer.print();
+}
+
+
+// -------------------------------------------------------------------------- //
+// Function optimizer
+
+// The pass and analysis managers are created once, and
+// reused for every function.
+struct Function_optimizer::State
+{
+  llvm::PassBuilder             pb;
+  llvm::LoopAnalysisManager     lam;
+  llvm::FunctionAnalysisManager fam;
+  llvm::CGSCCAnalysisManager    cgam;
+  llvm::ModuleAnalysisManager   mam;
+  llvm::FunctionPassManager     fpm;
+};
+
+
+Function_optimizer::Function_optimizer(int level)
+{
+  if (level == 0)
+    return;
+  state.reset(new State());
+  llvm::PassBuilder& pb = state->pb;
+  pb.registerModuleAnalyses(state->mam);
+  pb.registerCGSCCAnalyses(state->cgam);
+  pb.registerFunctionAnalyses(state->fam);
+  pb.registerLoopAnalyses(state->lam);
+  pb.crossRegisterProxies(state->lam, state->fam, state->cgam, state->mam);
+  state->fpm = pb.buildFunctionSimplificationPipeline(
+    get_level(level), llvm::ThinOrFullLTOPhase::None);
+}
+
+
+Function_optimizer::~Function_optimizer()
+{ }
+
+
+// Optimize the function f. Analyses of f are discarded
+// afterwards, since f is not revisited.
+void
+Function_optimizer::operator()(llvm::Function* f)
+{
+  if (!state)
+    return;
+  state->fpm.run(*f, state->fam);
+  state->fam.clear(*f, f->getName());
+}
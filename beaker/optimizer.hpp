@@ -0,0 +1,65 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef BEAKER_OPTIMIZER_HPP
+#define BEAKER_OPTIMIZER_HPP
+
+// The optimizer runs the standard LLVM pass pipeline
+// for an optimization level over a generated module.
+// Level 0 only runs the passes required for correct
+// code. Levels 1 to 3 promote allocas to registers and
+// run the scalar (instcombine, GVN), inlining, and loop
+// pipelines, each more aggressively than the last.
+
+#include <memory>
+
+namespace llvm
+{
+class Function;
+class Module;
+class TargetMachine;
+} // namespace llvm
+
+
+struct Optimizer
+{
+  Optimizer(int = 0);
+
+  void operator()(llvm::Module*);
+
+  int                  level;    // The optimization level (0 to 3)
+  bool                 timing;   // Report the time of each pass
+  llvm::TargetMachine* target;   // The target, if known
+};
+
+
+inline
+Optimizer::Optimizer(int n)
+  : level(n), timing(false), target(nullptr)
+{ }
+
+
+// The function optimizer runs the function simplification
+// pipeline of an optimization level over single functions,
+// as they are generated and before the module is optimized.
+// It depends neither on the target nor on the rest of the
+// module, so that functions can be optimized independently
+// of each other (e.g., in parallel, each in its own context)
+// with the same result. Level 0 runs no passes.
+//
+// A function optimizer shall be used by one thread at a time.
+class Function_optimizer
+{
+public:
+  Function_optimizer(int);
+  ~Function_optimizer();
+
+  void operator()(llvm::Function*);
+
+private:
+  struct State;
+  std::unique_ptr<State> state;
+};
+
+
+#endif
@@ -10,6 +10,7 @@
 #include "error.hpp"
 
 #include <iostream>
+#include <limits>
 #include <sstream>
 
 
@@ -43,6 +44,8 @@ Parser::primary_expr()
 // Parse a postfix expression.
 //
 //    postfix-expression -> postfix-expression '(' argument-list ')'
+//                       -> postfix-expression '[' expression ']'
+//                       -> postfix-expression '.' identifier
 //                       -> primary-expression
 Expr*
 Parser::postfix_expr()
@@ -60,6 +63,13 @@ Parser::postfix_expr()
       }
       match(rparen_tok);
       e1 = on_call(e1, args);
+    } else if (match_if(lbracket_tok)) {
+      Expr* i = expr();
+      match(rbracket_tok);
+      e1 = on_index(e1, i);
+    } else if (match_if(dot_tok)) {
+      Token n = match(identifier_tok);
+      e1 = on_member(e1, n);
     } else {
       break;
     }
@@ -255,13 +265,36 @@ Parser::expr()
 
 // Parse a type.
 //
-//    type -> 'bool' | 'int' | function-type | id-type
+//    type -> simple-type | array-type
+//
+//    array-type -> type '[' integer ']'
+//
+// Note that extents are given in the order of indexing:
+// T[m][n] is an array of m arrays of n objects of type T.
+Type const*
+Parser::type()
+{
+  Type const* t = simple_type();
+  std::vector<Token> ns;
+  while (match_if(lbracket_tok)) {
+    ns.push_back(match(integer_tok));
+    match(rbracket_tok);
+  }
+  for (auto iter = ns.rbegin(); iter != ns.rend(); ++iter)
+    t = on_array_type(t, *iter);
+  return t;
+}
+
+
+// Parse a simple type.
+//
+//    simple-type -> 'bool' | 'int' | function-type | id-type
 //
 //    function-type -> '(' type-list ')' '->' type
 //
 //    type-list -> type | type-list ',' type
 Type const*
-Parser::type()
+Parser::simple_type()
 {
   // id-type
   if (Token tok = match_if(identifier_tok))
@@ -466,9 +499,14 @@ Parser::empty_stmt()
 //    block-stmt -> '{' [stmt-seq] '}'
 //
 //    stmt-seq -> stmt | stmt stmt-seq
+//
+// Note that blocks are also parsed as the bodies of
+// functions and branches, so they record their own
+// location.
 Stmt*
 Parser::block_stmt()
 {
+  Location loc = ts_.location();
   Stmt_seq stmts;
   require(lbrace_tok);
   while (lookahead() != rbrace_tok) {
@@ -484,7 +522,10 @@ Parser::block_stmt()
   // TODO: This may be a generally unrecoverable error.
   term_ = rbrace_tok;
   match(rbrace_tok);
-  return on_block(stmts);
+  Stmt* s = on_block(stmts);
+  if (locs_)
+    locs_->emplace(s, loc);
+  return s;
 }
 
 
@@ -604,8 +645,23 @@ Parser::expression_stmt()
 //    stmt -> block-stmt
 //          | declaration-stmt
 //          | expression-stmt
+//
+// The location of a statement is that of its first
+// token.
 Stmt*
 Parser::stmt()
+{
+  Location loc = ts_.location();
+  Stmt* s = statement();
+  if (locs_)
+    locs_->emplace(s, loc);
+  return s;
+}
+
+
+// Select a statement parser by the first token.
+Stmt*
+Parser::statement()
 {
   switch (lookahead()) {
     case semicolon_tok:
@@ -768,6 +824,18 @@ Parser::on_id_type(Token tok)
   return t;
 }
 
+// The extent of an array shall be a positive integer
+// that fits in an int.
+Type const*
+Parser::on_array_type(Type const* t, Token tok)
+{
+  Integer const& n = cast<Integer_sym>(tok.symbol())->value();
+  if (n.sign() <= 0 || Integer(std::numeric_limits<int>::max()) < n)
+    error("invalid array extent");
+  return get_array_type(t, int(n.word()));
+}
+
+
 Expr*
 Parser::on_id(Token tok)
 {
@@ -907,26 +975,40 @@ Parser::on_call(Expr* e, Expr_seq const& a)
 }
 
 
+Expr*
+Parser::on_index(Expr* e, Expr* i)
+{
+  return new Index_expr(e, i);
+}
+
+
+Expr*
+Parser::on_member(Expr* e, Token tok)
+{
+  return new Member_expr(e, tok.symbol());
+}
+
+
 Decl*
 Parser::on_variable(Token tok, Type const* t)
 {
-  Expr* init = new Default_init(t);
-  return new Variable_decl(tok.symbol(), t, init);
+  Expr* e = new Default_init(t);
+  return init<Variable_decl>(tok.location(), tok.symbol(), t, e);
 }
 
 
 Decl*
 Parser::on_variable(Token tok, Type const* t, Expr* e)
 {
-  Expr* init = new Copy_init(t, e);
-  return new Variable_decl(tok.symbol(), t, init);
+  Expr* i = new Copy_init(t, e);
+  return init<Variable_decl>(tok.location(), tok.symbol(), t, i);
 }
 
 
 Decl*
 Parser::on_parameter_decl(Token tok, Type const* t)
 {
-  return new Parameter_decl(tok.symbol(), t);
+  return init<Parameter_decl>(tok.location(), tok.symbol(), t);
 }
 
 
@@ -934,21 +1016,21 @@ Decl*
 Parser::on_function_decl(Token tok, Decl_seq const& p, Type const* t, Stmt* b)
 {
   Type const* f = get_function_type(p, t);
-  return new Function_decl(tok.symbol(), f, p, b);
+  return init<Function_decl>(tok.location(), tok.symbol(), f, p, b);
 }
 
 
 Decl*
 Parser::on_record(Token n, Decl_seq const& fs)
 {
-  return new Record_decl(n.symbol(), fs);
+  return init<Record_decl>(n.location(), n.symbol(), fs);
 }
 
 
 Decl*
 Parser::on_field(Token n, Type const* t)
 {
-  return new Field_decl(n.symbol(), t);
+  return init<Field_decl>(n.location(), n.symbol(), t);
 }
 
 
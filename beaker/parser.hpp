@@ -35,6 +35,7 @@ public:
 
   // Type parsers
   Type const* type();
+  Type const* simple_type();
 
   // Declaration parsers
   Decl* decl();
@@ -46,6 +47,7 @@ public:
 
   // Statement parsers
   Stmt* stmt();
+  Stmt* statement();
   Stmt* empty_stmt();
   Stmt* block_stmt();
   Stmt* return_stmt();
@@ -67,6 +69,7 @@ public:
 private:
   // Actions
   Type const* on_id_type(Token);
+  Type const* on_array_type(Type const*, Token);
   Expr* on_id(Token);
   Expr* on_bool(Token);
   Expr* on_int(Token);
@@ -87,6 +90,8 @@ private:
   Expr* on_or(Expr*, Expr*);
   Expr* on_not(Expr*);
   Expr* on_call(Expr*, Expr_seq const&);
+  Expr* on_index(Expr*, Expr*);
+  Expr* on_member(Expr*, Token);
 
   Decl* on_variable(Token, Type const*);
   Decl* on_variable(Token, Type const*, Expr*);
@@ -167,7 +172,8 @@ inline T*
 Parser::init(Location loc, Args&&... args)
 {
   T* t = new T(std::forward<Args>(args)...);
-  locs_->emplace(t, loc);
+  if (locs_)
+    locs_->emplace(t, loc);
   return t;
 }
 
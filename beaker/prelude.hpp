@@ -36,6 +36,8 @@ struct And_expr;
 struct Or_expr;
 struct Not_expr;
 struct Call_expr;
+struct Member_expr;
+struct Index_expr;
 struct Value_conv;
 struct Default_init;
 struct Copy_init;
@@ -47,6 +49,7 @@ struct Integer_type;
 struct Function_type;
 struct Reference_type;
 struct Record_type;
+struct Array_type;
 
 struct Decl;
 struct Variable_decl;
@@ -25,6 +25,7 @@ operator<<(std::ostream& os, Type const& t)
     void operator()(Function_type const* t) { os << *t; }
     void operator()(Reference_type const* t) { os << *t; }
     void operator()(Record_type const* t) { os << *t; }
+    void operator()(Array_type const* t) { os << *t; }
   };
 
   apply(&t, Fn{os});
@@ -84,6 +85,13 @@ operator<<(std::ostream& os, Record_type const& t)
 }
 
 
+std::ostream&
+operator<<(std::ostream& os, Array_type const& t)
+{
+  return os << *t.type() << '[' << t.extent() << ']';
+}
+
+
 // -------------------------------------------------------------------------- //
 // Expressions
 
@@ -113,6 +121,8 @@ operator<<(std::ostream& os, Expr const& e)
     void operator()(Or_expr const* e) { os << *e; }
     void operator()(Not_expr const* e) { os << *e; }
     void operator()(Call_expr const* e) { os << *e; }
+    void operator()(Member_expr const* e) { os << *e; }
+    void operator()(Index_expr const* e) { os << *e; }
     void operator()(Value_conv const* e) { os << *e; }
     void operator()(Default_init const* e) { os << *e; }
     void operator()(Copy_init const* e) { os << *e; }
@@ -255,6 +265,20 @@ operator<<(std::ostream& os, Call_expr const&)
 }
 
 
+std::ostream&
+operator<<(std::ostream& os, Member_expr const& e)
+{
+  return os << *e.object() << '.' << e.name()->spelling();
+}
+
+
+std::ostream&
+operator<<(std::ostream& os, Index_expr const& e)
+{
+  return os << *e.array() << '[' << *e.index() << ']';
+}
+
+
 std::ostream&
 operator<<(std::ostream& os, Value_conv const& e)
 {
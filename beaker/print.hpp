@@ -15,6 +15,7 @@ std::ostream& operator<<(std::ostream&, Integer_type const&);
 std::ostream& operator<<(std::ostream&, Function_type const&);
 std::ostream& operator<<(std::ostream&, Reference_type const&);
 std::ostream& operator<<(std::ostream&, Record_type const&);
+std::ostream& operator<<(std::ostream&, Array_type const&);
 
 std::ostream& operator<<(std::ostream&, Expr const&);
 std::ostream& operator<<(std::ostream&, Literal_expr const&);
@@ -36,6 +37,8 @@ std::ostream& operator<<(std::ostream&, And_expr const&);
 std::ostream& operator<<(std::ostream&, Or_expr const&);
 std::ostream& operator<<(std::ostream&, Not_expr const&);
 std::ostream& operator<<(std::ostream&, Call_expr const&);
+std::ostream& operator<<(std::ostream&, Member_expr const&);
+std::ostream& operator<<(std::ostream&, Index_expr const&);
 std::ostream& operator<<(std::ostream&, Value_conv const&);
 std::ostream& operator<<(std::ostream&, Default_init const&);
 std::ostream& operator<<(std::ostream&, Copy_init const&);
@@ -0,0 +1,147 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "profile.hpp"
+#include "decl.hpp"
+#include "stmt.hpp"
+#include "file.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+
+namespace
+{
+
+// Returns the name of a kind of statement.
+char const*
+stmt_name(Stmt const* s)
+{
+  switch (s->kind()) {
+    case Stmt::empty_stmt: return "empty";
+    case Stmt::block_stmt: return "block";
+    case Stmt::assign_stmt: return "assign";
+    case Stmt::return_stmt: return "return";
+    case Stmt::if_then_stmt: return "if";
+    case Stmt::if_else_stmt: return "if-else";
+    case Stmt::while_stmt: return "while";
+    case Stmt::break_stmt: return "break";
+    case Stmt::continue_stmt: return "continue";
+    case Stmt::expression_stmt: return "expression";
+    case Stmt::declaration_stmt: return "declaration";
+  }
+  throw std::logic_error("invalid statement kind");
+}
+
+
+inline double
+milliseconds(Profiler::Duration d)
+{
+  return std::chrono::duration<double, std::milli>(d).count();
+}
+
+
+inline long long
+nanoseconds(Profiler::Duration d)
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+}
+
+} // namespace
+
+
+// Returns the profile of f, or nullptr if f was
+// never executed.
+Profiler::Entry const*
+Profiler::entry(Function_decl const* f) const
+{
+  auto iter = fns.find(f);
+  return iter != fns.end() ? &iter->second : nullptr;
+}
+
+
+// Returns the profile of s, or nullptr if s was
+// never executed.
+Profiler::Entry const*
+Profiler::entry(Stmt const* s) const
+{
+  auto iter = stmts.find(s);
+  return iter != stmts.end() ? &iter->second : nullptr;
+}
+
+
+// A profiled node, as reported.
+struct Profiler::Row
+{
+  char const*  kind;  // "function" or "statement"
+  String       name;  // Function name or statement kind
+  Location     loc;
+  Entry const* entry;
+};
+
+
+// Returns the rows of the profile, ordered by decreasing
+// exclusive time. Ties are ordered by source location so
+// that the order is stable between runs.
+std::vector<Profiler::Row>
+Profiler::rows(Location_map const& locs) const
+{
+  std::vector<Row> rs;
+  for (auto const& x : fns)
+    rs.push_back({"function", x.first->name()->spelling(),
+                  locs.get(x.first), &x.second});
+  for (auto const& x : stmts)
+    rs.push_back({"statement", stmt_name(x.first),
+                  locs.get(x.first), &x.second});
+
+  std::sort(rs.begin(), rs.end(), [](Row const& a, Row const& b) {
+    if (a.entry->exclusive != b.entry->exclusive)
+      return a.entry->exclusive > b.entry->exclusive;
+    if (a.loc.line() != b.loc.line())
+      return a.loc.line() < b.loc.line();
+    return a.loc.column() < b.loc.column();
+  });
+  return rs;
+}
+
+
+// Write a human-readable report of the profile to os.
+// Times are in milliseconds.
+void
+Profiler::report(std::ostream& os, Location_map const& locs) const
+{
+  std::ios_base::fmtflags flags = os.flags();
+  os << std::fixed << std::setprecision(3);
+  os << std::setw(12) << "self (ms)"
+     << std::setw(12) << "total (ms)"
+     << std::setw(12) << "count"
+     << "  location  node\n";
+  for (Row const& r : rows(locs)) {
+    os << std::setw(12) << milliseconds(r.entry->exclusive)
+       << std::setw(12) << milliseconds(r.entry->inclusive)
+       << std::setw(12) << r.entry->count
+       << "  " << r.loc.line() << ':' << r.loc.column()
+       << "  " << r.kind << ' ' << r.name << '\n';
+  }
+  os.flags(flags);
+}
+
+
+// Write the profile to os as tab-separated values, one
+// node per line, following a header line. Times are in
+// nanoseconds.
+void
+Profiler::dump(std::ostream& os, Location_map const& locs) const
+{
+  os << "kind\tname\tfile\tline\tcolumn\tcount\tinclusive\texclusive\n";
+  for (Row const& r : rows(locs)) {
+    os << r.kind << '\t' << r.name << '\t';
+    if (r.loc.file())
+      os << r.loc.file()->pathname();
+    os << '\t' << r.loc.line() << '\t' << r.loc.column()
+       << '\t' << r.entry->count
+       << '\t' << nanoseconds(r.entry->inclusive)
+       << '\t' << nanoseconds(r.entry->exclusive) << '\n';
+  }
+}
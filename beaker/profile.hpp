@@ -0,0 +1,115 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef BEAKER_PROFILE_HPP
+#define BEAKER_PROFILE_HPP
+
+// The profiler records the execution of a program by
+// the evaluator. For every function and statement that
+// is executed, the profiler counts its executions and
+// measures the time spent in it. Inclusive time is the
+// time from entering a node until leaving it. Exclusive
+// time excludes the time spent in nested statements and
+// in the functions that it calls.
+//
+// Profiling is deterministic: every execution of a node
+// is recorded. Nodes are reported by their source
+// location.
+
+#include "prelude.hpp"
+#include "location.hpp"
+
+#include <chrono>
+#include <iosfwd>
+#include <unordered_map>
+#include <vector>
+
+
+class Profiler
+{
+public:
+  using Clock    = std::chrono::steady_clock;
+  using Duration = Clock::duration;
+
+  // The profile of a single function or statement.
+  // Note that inclusive time is only accumulated by
+  // the outermost activation of a recursive node.
+  struct Entry
+  {
+    std::size_t count = 0;
+    Duration    inclusive = Duration::zero();
+    Duration    exclusive = Duration::zero();
+    int         active = 0;
+  };
+
+  void enter(Function_decl const*);
+  void enter(Stmt const*);
+  void leave();
+
+  Entry const* entry(Function_decl const*) const;
+  Entry const* entry(Stmt const*) const;
+
+  void report(std::ostream&, Location_map const&) const;
+  void dump(std::ostream&, Location_map const&) const;
+
+private:
+  // An active function or statement.
+  struct Activation
+  {
+    Entry*            entry;
+    Clock::time_point start;
+    Duration          nested;
+  };
+
+  struct Row;
+  std::vector<Row> rows(Location_map const&) const;
+
+  void enter(Entry&);
+
+  std::unordered_map<Function_decl const*, Entry> fns;
+  std::unordered_map<Stmt const*, Entry>          stmts;
+  std::vector<Activation>                         active;
+};
+
+
+inline void
+Profiler::enter(Function_decl const* f)
+{
+  enter(fns[f]);
+}
+
+
+inline void
+Profiler::enter(Stmt const* s)
+{
+  enter(stmts[s]);
+}
+
+
+// Start a new activation of e.
+inline void
+Profiler::enter(Entry& e)
+{
+  ++e.count;
+  ++e.active;
+  active.push_back({&e, Clock::now(), Duration::zero()});
+}
+
+
+// Finish the innermost activation, charging its time
+// to its entry and to the enclosing activation.
+inline void
+Profiler::leave()
+{
+  Activation a = active.back();
+  active.pop_back();
+  Duration d = Clock::now() - a.start;
+  a.entry->exclusive += d - a.nested;
+  if (--a.entry->active == 0)
+    a.entry->inclusive += d;
+  if (!active.empty())
+    active.back().nested += d;
+}
+
+
+#endif
@@ -0,0 +1,237 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "elaborator.hpp"
+#include "fold.hpp"
+#include "type.hpp"
+#include "decl.hpp"
+#include "generator.hpp"
+#include "optimizer.hpp"
+#include "target.hpp"
+#include "error.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Target/TargetMachine.h>
+
+
+using namespace std;
+
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+
+// Returns the number of milliseconds since t.
+double
+elapsed(Clock::time_point t)
+{
+  std::chrono::duration<double, std::milli> d = Clock::now() - t;
+  return d.count();
+}
+
+
+// The trap function of native code. Integer overflow
+// (when arithmetic is checked), division by 0, and
+// array indexes that are out of bounds trap.
+void
+trap()
+{
+  std::cerr << "error: runtime check failed\n";
+  std::exit(-1);
+}
+
+
+// Print an LLVM error and return the exit status of
+// a failed run.
+int
+fail(llvm::Error err)
+{
+  std::cerr << "error: " << llvm::toString(std::move(err)) << '\n';
+  return -1;
+}
+
+} // namespace
+
+
+int
+main(int argc, char* argv[])
+{
+  // Prepare the symbol table.
+  Symbol_table syms;
+  init_symbols(syms);
+
+  // Parse command line options. The input file is the
+  // first argument that is not an option.
+  //
+  //    --unchecked
+  //             Integer arithmetic wraps on overflow
+  //             instead of trapping.
+  //
+  //    -O0, -O1, -O2, -O3
+  //             Run the optimization pipeline of the given
+  //             level before compiling. The default is -O2.
+  Arithmetic arith = checked_arithmetic;
+  Optimizer opt(2);
+  char const* input = nullptr;
+  for (int i = 1; i < argc; ++i) {
+    String arg = argv[i];
+    if (arg == "--unchecked") {
+      arith = wrapping_arithmetic;
+    } else if (arg.size() == 3 && arg[0] == '-' && arg[1] == 'O'
+                               && '0' <= arg[2] && arg[2] <= '3') {
+      opt.level = arg[2] - '0';
+    } else if (arg[0] == '-') {
+      std::cerr << "error: unknown option '" << arg << "'\n";
+      return -1;
+    } else {
+      input = argv[i];
+    }
+  }
+  if (!input) {
+    std::cerr << "usage: beaker-run [--unchecked] [-O0 | -O1 | -O2 | -O3] "
+                 "input.bkr\n";
+    return -1;
+  }
+
+  // Create the JIT for the host, and make the trap
+  // function visible to native code.
+  llvm::InitializeNativeTarget();
+  llvm::InitializeNativeTargetAsmPrinter();
+  auto jtmb = llvm::orc::JITTargetMachineBuilder::detectHost();
+  if (!jtmb)
+    return fail(jtmb.takeError());
+  jtmb->setCodeGenOptLevel(opt.level ? llvm::CodeGenOpt::Default
+                                     : llvm::CodeGenOpt::None);
+  auto jit = llvm::orc::LLJITBuilder().setJITTargetMachineBuilder(*jtmb).create();
+  if (!jit)
+    return fail(jit.takeError());
+  llvm::orc::SymbolMap natives;
+  natives[(*jit)->mangleAndIntern("__beaker_trap")] = llvm::JITEvaluatedSymbol(
+    llvm::pointerToJITTargetAddress(&trap),
+    llvm::JITSymbolFlags::Exported);
+  if (llvm::Error err = (*jit)->getMainJITDylib().define(
+        llvm::orc::absoluteSymbols(std::move(natives))))
+    return fail(std::move(err));
+
+  // The optimizer tunes code for the host.
+  std::unique_ptr<llvm::TargetMachine> target;
+  try {
+    target = make_target("", "native", opt.level);
+  } catch (std::runtime_error& err) {
+    std::cerr << "error: " << err.what() << '\n';
+    return -1;
+  }
+  opt.target = target.get();
+
+  // Prepare the input buffer.
+  File src = input;
+  Input_buffer in = src;
+
+  try {
+    Clock::time_point start = Clock::now();
+
+    // Create the token stream over. This will be populated
+    // by the lexer.
+    Token_stream ts;
+
+    // Build and run the lexer.
+    Lexer lex(syms, in);
+    if (!lex.lex(ts))
+      return -1;
+
+    // Build and run the parser. The location map
+    // is used to save source locations, which are
+    // used to diagnose elaboration errors.
+    Location_map locs;
+    Parser parse(syms, ts, locs);
+    Decl* m = parse.module();
+    if (!parse)
+      return -1;
+
+    // Perform semantic analysis.
+    Elaborator elab(locs);
+    elab.elaborate(m);
+
+    // Replace constant expressions with literals.
+    Folder folder(syms);
+    folder.fold(m);
+
+    // Find an entry point. Its result is returned as a
+    // 64-bit integer or a boolean, so that it can be
+    // printed as the evaluator prints it.
+    Function_decl const* f = elab.main;
+    if (!f) {
+      std::cout << "no main\n";
+      return 0;
+    }
+    Type const* t = f->return_type();
+    if (!f->parameters().empty() || (!is<Integer_type>(t) && !is<Boolean_type>(t))) {
+      std::cerr << "error: main must take no arguments and return int or bool\n";
+      return -1;
+    }
+
+    // Translate to LLVM. The generator creates the module
+    // in its own context, which is passed to the JIT.
+    std::unique_ptr<llvm::LLVMContext> cxt(new llvm::LLVMContext());
+    Generator gen(*cxt);
+    gen.arith = arith;
+    gen.level = opt.level;
+    gen.trap_fn = "__beaker_trap";
+    std::unique_ptr<llvm::Module> mod(gen(m));
+    if (llvm::verifyModule(*mod, &llvm::errs()))
+      return -1;
+    mod->setDataLayout((*jit)->getDataLayout());
+    mod->setTargetTriple((*jit)->getTargetTriple().str());
+
+    // Optimize and compile the module. Compilation happens
+    // when main is first looked up.
+    opt(mod.get());
+    llvm::orc::ThreadSafeModule tsm(std::move(mod), std::move(cxt));
+    if (llvm::Error err = (*jit)->addIRModule(std::move(tsm)))
+      return fail(std::move(err));
+    auto sym = (*jit)->lookup(f->name()->spelling());
+    if (!sym)
+      return fail(sym.takeError());
+    double compile_time = elapsed(start);
+
+    // Run the program, starting with the initializers of
+    // global variables that were not computed statically.
+    start = Clock::now();
+    if (llvm::Error err = (*jit)->initialize((*jit)->getMainJITDylib()))
+      return fail(std::move(err));
+    Value v;
+    if (is<Boolean_type>(t)) {
+      auto fn = reinterpret_cast<bool (*)()>(sym->getAddress());
+      v = Integer_value(fn());
+    } else {
+      auto fn = reinterpret_cast<std::int64_t (*)()>(sym->getAddress());
+      v = Integer_value(fn());
+    }
+    double run_time = elapsed(start);
+    std::cout << v << '\n';
+
+    std::cerr << "compile: " << compile_time << " ms\n"
+              << "execute: " << run_time << " ms\n";
+  }
+
+  // Diagnose uncaught translation errors and exit
+  // gracefully. All other uncaught exceptions are
+  // ICEs and we want those to fail noisily.
+  catch (Translation_error& err) {
+    diagnose(err);
+    return -1;
+  }
+}
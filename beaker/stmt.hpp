@@ -11,10 +11,34 @@ struct Stmt
   struct Visitor;
   struct Mutator;
 
+  // The kinds of statements.
+  enum Kind
+  {
+    empty_stmt,
+    block_stmt,
+    assign_stmt,
+    return_stmt,
+    if_then_stmt,
+    if_else_stmt,
+    while_stmt,
+    break_stmt,
+    continue_stmt,
+    expression_stmt,
+    declaration_stmt,
+  };
+
+  Stmt(Kind k)
+    : kind_(k)
+  { }
+
   virtual ~Stmt() { }
 
   virtual void accept(Visitor&) const = 0;
   virtual void accept(Mutator&) = 0;
+
+  Kind kind() const { return kind_; }
+
+  Kind kind_;
 };
 
 
@@ -56,6 +80,12 @@ struct Stmt::Mutator
 // The empty statement.
 struct Empty_stmt : Stmt
 {
+  Empty_stmt()
+    : Stmt(empty_stmt)
+  { }
+
+  static bool classof(Stmt const* s) { return s->kind() == empty_stmt; }
+
   void accept(Visitor& v) const { return v.visit(this); }
   void accept(Mutator& v)       { return v.visit(this); }
 };
@@ -65,9 +95,11 @@ struct Empty_stmt : Stmt
 struct Block_stmt : Stmt
 {
   Block_stmt(Stmt_seq const& s)
-    : first(s)
+    : Stmt(block_stmt), first(s)
   { }
 
+  static bool classof(Stmt const* s) { return s->kind() == block_stmt; }
+
   void accept(Visitor& v) const { return v.visit(this); }
   void accept(Mutator& v)       { return v.visit(this); }
 
@@ -83,9 +115,11 @@ struct Block_stmt : Stmt
 struct Assign_stmt : Stmt
 {
   Assign_stmt(Expr* e1, Expr* e2)
-    : first(e1), second(e2)
+    : Stmt(assign_stmt), first(e1), second(e2)
   { }
 
+  static bool classof(Stmt const* s) { return s->kind() == assign_stmt; }
+
   void accept(Visitor& v) const { return v.visit(this); }
   void accept(Mutator& v)       { return v.visit(this); }
 
@@ -101,9 +135,11 @@ struct Assign_stmt : Stmt
 struct Return_stmt : Stmt
 {
   Return_stmt(Expr* e)
-    : first(e)
+    : Stmt(return_stmt), first(e)
   { }
 
+  static bool classof(Stmt const* s) { return s->kind() == return_stmt; }
+
   void accept(Visitor& v) const { return v.visit(this); }
   void accept(Mutator& v)       { return v.visit(this); }
 
@@ -119,9 +155,11 @@ struct Return_stmt : Stmt
 struct If_then_stmt : Stmt
 {
   If_then_stmt(Expr* e, Stmt* s)
-    : first(e), second(s)
+    : Stmt(if_then_stmt), first(e), second(s)
   { }
 
+  static bool classof(Stmt const* s) { return s->kind() == if_then_stmt; }
+
   void accept(Visitor& v) const { return v.visit(this); }
   void accept(Mutator& v)       { return v.visit(this); }
 
@@ -139,9 +177,11 @@ struct If_then_stmt : Stmt
 struct If_else_stmt : Stmt
 {
   If_else_stmt(Expr* e, Stmt* s1, Stmt* s2)
-    : first(e), second(s1), third(s2)
+    : Stmt(if_else_stmt), first(e), second(s1), third(s2)
   { }
 
+  static bool classof(Stmt const* s) { return s->kind() == if_else_stmt; }
+
   void accept(Visitor& v) const { return v.visit(this); }
   void accept(Mutator& v)       { return v.visit(this); }
 
@@ -161,9 +201,11 @@ struct If_else_stmt : Stmt
 struct While_stmt : Stmt
 {
   While_stmt(Expr* e, Stmt* s)
-    : first(e), second(s)
+    : Stmt(while_stmt), first(e), second(s)
   { }
 
+  static bool classof(Stmt const* s) { return s->kind() == while_stmt; }
+
   void accept(Visitor& v) const { return v.visit(this); }
   void accept(Mutator& v)       { return v.visit(this); }
 
@@ -178,7 +220,11 @@ struct While_stmt : Stmt
 // A break statement.
 struct Break_stmt : Stmt
 {
-  using Stmt::Stmt;
+  Break_stmt()
+    : Stmt(break_stmt)
+  { }
+
+  static bool classof(Stmt const* s) { return s->kind() == break_stmt; }
 
   void accept(Visitor& v) const { return v.visit(this); }
   void accept(Mutator& v)       { return v.visit(this); }
@@ -188,7 +234,11 @@ struct Break_stmt : Stmt
 // A break statement.
 struct Continue_stmt : Stmt
 {
-  using Stmt::Stmt;
+  Continue_stmt()
+    : Stmt(continue_stmt)
+  { }
+
+  static bool classof(Stmt const* s) { return s->kind() == continue_stmt; }
 
   void accept(Visitor& v) const { return v.visit(this); }
   void accept(Mutator& v)       { return v.visit(this); }
@@ -199,9 +249,11 @@ struct Continue_stmt : Stmt
 struct Expression_stmt : Stmt
 {
   Expression_stmt(Expr* e)
-    : first(e)
+    : Stmt(expression_stmt), first(e)
   { }
 
+  static bool classof(Stmt const* s) { return s->kind() == expression_stmt; }
+
   void accept(Visitor& v) const { return v.visit(this); }
   void accept(Mutator& v)       { return v.visit(this); }
 
@@ -215,9 +267,11 @@ struct Expression_stmt : Stmt
 struct Declaration_stmt : Stmt
 {
   Declaration_stmt(Decl* d)
-    : first(d)
+    : Stmt(declaration_stmt), first(d)
   { }
 
+  static bool classof(Stmt const* s) { return s->kind() == declaration_stmt; }
+
   void accept(Visitor& v) const { return v.visit(this); }
   void accept(Mutator& v)       { return v.visit(this); }
 
@@ -251,12 +305,26 @@ struct Generic_stmt_visitor : Stmt::Visitor, lingo::Generic_visitor<F, T>
 };
 
 
+// Apply fn to the statement s. Dispatch is by the kind
+// of the statement.
 template<typename F, typename T = typename std::result_of<F(Empty_stmt const*)>::type>
 inline T
 apply(Stmt const* s, F fn)
 {
-  Generic_stmt_visitor<F, T> v(fn);
-  return lingo::accept(s, v);
+  switch (s->kind()) {
+    case Stmt::empty_stmt: return fn(static_cast<Empty_stmt const*>(s));
+    case Stmt::block_stmt: return fn(static_cast<Block_stmt const*>(s));
+    case Stmt::assign_stmt: return fn(static_cast<Assign_stmt const*>(s));
+    case Stmt::return_stmt: return fn(static_cast<Return_stmt const*>(s));
+    case Stmt::if_then_stmt: return fn(static_cast<If_then_stmt const*>(s));
+    case Stmt::if_else_stmt: return fn(static_cast<If_else_stmt const*>(s));
+    case Stmt::while_stmt: return fn(static_cast<While_stmt const*>(s));
+    case Stmt::break_stmt: return fn(static_cast<Break_stmt const*>(s));
+    case Stmt::continue_stmt: return fn(static_cast<Continue_stmt const*>(s));
+    case Stmt::expression_stmt: return fn(static_cast<Expression_stmt const*>(s));
+    case Stmt::declaration_stmt: return fn(static_cast<Declaration_stmt const*>(s));
+  }
+  throw std::logic_error("invalid statement kind");
 }
 
 
@@ -285,12 +353,26 @@ struct Generic_stmt_mutator : Stmt::Mutator, lingo::Generic_mutator<F, T>
 };
 
 
+// Apply fn to the statement s. Dispatch is by the kind
+// of the statement.
 template<typename F, typename T = typename std::result_of<F(Empty_stmt*)>::type>
 inline T
 apply(Stmt* s, F fn)
 {
-  Generic_stmt_mutator<F, T> m(fn);
-  return lingo::accept(s, m);
+  switch (s->kind()) {
+    case Stmt::empty_stmt: return fn(static_cast<Empty_stmt*>(s));
+    case Stmt::block_stmt: return fn(static_cast<Block_stmt*>(s));
+    case Stmt::assign_stmt: return fn(static_cast<Assign_stmt*>(s));
+    case Stmt::return_stmt: return fn(static_cast<Return_stmt*>(s));
+    case Stmt::if_then_stmt: return fn(static_cast<If_then_stmt*>(s));
+    case Stmt::if_else_stmt: return fn(static_cast<If_else_stmt*>(s));
+    case Stmt::while_stmt: return fn(static_cast<While_stmt*>(s));
+    case Stmt::break_stmt: return fn(static_cast<Break_stmt*>(s));
+    case Stmt::continue_stmt: return fn(static_cast<Continue_stmt*>(s));
+    case Stmt::expression_stmt: return fn(static_cast<Expression_stmt*>(s));
+    case Stmt::declaration_stmt: return fn(static_cast<Declaration_stmt*>(s));
+  }
+  throw std::logic_error("invalid statement kind");
 }
 
 
@@ -6,6 +6,7 @@
 
 #include "string.hpp"
 #include "cast.hpp"
+#include "integer.hpp"
 
 #include <unordered_map>
 #include <typeinfo>
@@ -73,23 +74,21 @@ struct Boolean_sym : Symbol
 };
 
 
-// Represents all integer symbols.
-//
-// TODO: Develop and use a good arbitrary precision
-// integer for this representation.
+// Represents all integer symbols. The value of an
+// integer symbol has arbitrary precision.
 //
 // TOOD: Track the integer base? Technically, that
 // can be inferred by the spelling, but it might be
 // useful to keep cached.
 struct Integer_sym : Symbol
 {
-  Integer_sym(int k, int n)
+  Integer_sym(int k, Integer const& n)
     : Symbol(k), value_(n)
   { }
 
-  int value() const { return value_; }
+  Integer const& value() const { return value_; }
 
-  int value_;
+  Integer value_;
 };
 
 
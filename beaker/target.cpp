@@ -0,0 +1,142 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "target.hpp"
+
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/Triple.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IR/Module.h>
+#include <llvm/MC/SubtargetFeature.h>
+#include <llvm/MC/TargetRegistry.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetMachine.h>
+#include <llvm/Target/TargetOptions.h>
+
+#include <stdexcept>
+
+
+namespace
+{
+
+// Register every target that LLVM was built with. This
+// is done once.
+void
+init_targets()
+{
+  static bool done = false;
+  if (done)
+    return;
+  llvm::InitializeAllTargetInfos();
+  llvm::InitializeAllTargets();
+  llvm::InitializeAllTargetMCs();
+  llvm::InitializeAllAsmPrinters();
+  done = true;
+}
+
+
+llvm::CodeGenOpt::Level
+get_level(int n)
+{
+  switch (n) {
+    case 0: return llvm::CodeGenOpt::None;
+    case 1: return llvm::CodeGenOpt::Less;
+    case 2: return llvm::CodeGenOpt::Default;
+    default: return llvm::CodeGenOpt::Aggressive;
+  }
+}
+
+} // namespace
+
+
+// Create a target machine for the architecture arch and
+// the processor cpu, generating code at the optimization
+// level n. When arch is empty, code is generated for the
+// host. When cpu is "native", code is tuned for, and may
+// use every feature of, the host processor. Code is
+// position independent, so that objects can be linked
+// into any executable.
+std::unique_ptr<llvm::TargetMachine>
+make_target(String const& arch, String const& cpu, int n)
+{
+  init_targets();
+
+  llvm::Triple triple(llvm::sys::getDefaultTargetTriple());
+  std::string err;
+  llvm::Target const* t = llvm::TargetRegistry::lookupTarget(arch, triple, err);
+  if (!t)
+    throw std::runtime_error("unknown architecture '" + arch + "'");
+
+  String name = cpu;
+  llvm::SubtargetFeatures features;
+  if (cpu == "native") {
+    name = llvm::sys::getHostCPUName().str();
+    llvm::StringMap<bool> host;
+    if (llvm::sys::getHostCPUFeatures(host)) {
+      for (auto const& f : host)
+        features.AddFeature(f.first(), f.second);
+    }
+  }
+
+  llvm::TargetOptions opts;
+  llvm::TargetMachine* tm =
+    t->createTargetMachine(triple.str(), name, features.getString(), opts,
+                           llvm::Reloc::PIC_, llvm::None, get_level(n));
+  if (!tm)
+    throw std::runtime_error("cannot generate code for '" + triple.str() + "'");
+  return std::unique_ptr<llvm::TargetMachine>(tm);
+}
+
+
+// Set the target triple and data layout of the module m
+// to those of the target machine tm. This shall be done
+// before the module is optimized.
+void
+configure(llvm::Module* m, llvm::TargetMachine* tm)
+{
+  m->setTargetTriple(tm->getTargetTriple().str());
+  m->setDataLayout(tm->createDataLayout());
+}
+
+
+// Write the module m to the stream os in the format f.
+// Native code is generated by the target machine tm. A
+// stream that cannot seek (e.g., a pipe) is buffered, so
+// that the object writer can patch earlier output.
+void
+emit(llvm::Module* m,
+     llvm::TargetMachine* tm,
+     Output_format f,
+     llvm::raw_fd_ostream& os)
+{
+  switch (f) {
+    case ir_format:
+      os << *m;
+      return;
+
+    case bitcode_format:
+      llvm::WriteBitcodeToFile(*m, os);
+      return;
+
+    case assembly_format:
+    case object_format: {
+      std::unique_ptr<llvm::buffer_ostream> buf;
+      llvm::raw_pwrite_stream* out = &os;
+      if (!os.supportsSeeking()) {
+        buf.reset(new llvm::buffer_ostream(os));
+        out = buf.get();
+      }
+
+      llvm::CodeGenFileType t = f == object_format ? llvm::CGFT_ObjectFile
+                                                   : llvm::CGFT_AssemblyFile;
+      llvm::legacy::PassManager pm;
+      if (tm->addPassesToEmitFile(pm, *out, nullptr, t))
+        throw std::runtime_error("cannot emit code for the target");
+      pm.run(*m);
+      return;
+    }
+  }
+}
@@ -0,0 +1,41 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef BEAKER_TARGET_HPP
+#define BEAKER_TARGET_HPP
+
+// The target module configures code generation for a
+// machine and writes generated modules as LLVM IR,
+// bitcode, assembly, or object code.
+
+#include "string.hpp"
+
+#include <memory>
+
+namespace llvm
+{
+class Module;
+class TargetMachine;
+class raw_fd_ostream;
+} // namespace llvm
+
+
+// The formats of compiled output.
+enum Output_format
+{
+  ir_format,        // Textual LLVM IR
+  bitcode_format,   // LLVM bitcode
+  assembly_format,  // Native assembly
+  object_format,    // Native object code
+};
+
+
+std::unique_ptr<llvm::TargetMachine> make_target(String const&,
+                                                 String const&,
+                                                 int);
+
+void configure(llvm::Module*, llvm::TargetMachine*);
+void emit(llvm::Module*, llvm::TargetMachine*, Output_format, llvm::raw_fd_ostream&);
+
+
+#endif
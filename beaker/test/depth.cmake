@@ -0,0 +1,24 @@
+# Copyright (c) 2015 Andrew Sutton
+# All rights reserved
+
+# Check that a recursion deeper than the depth limit fails
+# with the same error whether it is interpreted, compiled,
+# or run by the bytecode machine.
+#
+#   cmake -DINTERPRETER=beaker-interpret -DPROGRAM=test/depth-1.bkr
+#         -P depth.cmake
+
+set(failed 0)
+foreach(options "" "--jit=1" "--vm")
+  execute_process(
+    COMMAND ${INTERPRETER} ${options} ${PROGRAM}
+    OUTPUT_VARIABLE output
+    ERROR_VARIABLE output)
+  if(NOT output MATCHES "maximum call depth exceeded")
+    message(SEND_ERROR "${options}: ${output}")
+    set(failed 1)
+  endif()
+endforeach()
+if(failed)
+  message(FATAL_ERROR "the depth limit is not enforced")
+endif()
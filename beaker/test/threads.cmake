@@ -0,0 +1,39 @@
+# Copyright (c) 2015 Andrew Sutton
+# All rights reserved
+
+# Check that beaker-compile writes the same module for every
+# program in test/codegen, whatever the number of threads.
+#
+#   cmake -DCOMPILER=beaker-compile -DTESTS=test/codegen
+#         -DOUTPUT=dir -P threads.cmake
+
+file(GLOB programs ${TESTS}/*.bkr)
+file(MAKE_DIRECTORY ${OUTPUT})
+set(failed 0)
+foreach(program ${programs})
+  get_filename_component(name ${program} NAME_WE)
+  foreach(options "-O0" "-O2" "-O0;-g" "-O2;-g")
+    set(expected "")
+    foreach(threads 1 2 4)
+      set(output ${OUTPUT}/${name}-${threads}.ll)
+      execute_process(
+        COMMAND ${COMPILER} ${options} --threads=${threads} ${program} -o ${output}
+        RESULT_VARIABLE status)
+      if(NOT status EQUAL 0)
+        message(SEND_ERROR "${name} ${options} --threads=${threads}: failed")
+        set(failed 1)
+      else()
+        file(READ ${output} actual)
+        if(threads EQUAL 1)
+          set(expected "${actual}")
+        elseif(NOT actual STREQUAL expected)
+          message(SEND_ERROR "${name} ${options} --threads=${threads}: differs from --threads=1")
+          set(failed 1)
+        endif()
+      endif()
+    endforeach()
+  endforeach()
+endforeach()
+if(failed)
+  message(FATAL_ERROR "output depends on the number of threads")
+endif()
@@ -11,7 +11,10 @@ spelling(Token_kind k)
     case rbrace_tok: return "}";
     case lparen_tok: return "(";
     case rparen_tok: return ")";
+    case lbracket_tok: return "[";
+    case rbracket_tok: return "]";
     case comma_tok: return ",";
+    case dot_tok: return ".";
     case colon_tok: return ":";
     case semicolon_tok: return ";";
     case equal_tok: return "=";
@@ -57,7 +60,10 @@ init_symbols(Symbol_table& syms)
   syms.put<Symbol>("}", rbrace_tok);
   syms.put<Symbol>("(", lparen_tok);
   syms.put<Symbol>(")", rparen_tok);
+  syms.put<Symbol>("[", lbracket_tok);
+  syms.put<Symbol>("]", rbracket_tok);
   syms.put<Symbol>(",", comma_tok);
+  syms.put<Symbol>(".", dot_tok);
   syms.put<Symbol>(":", colon_tok);
   syms.put<Symbol>(";", semicolon_tok);
   syms.put<Symbol>("=", equal_tok);
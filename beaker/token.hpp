@@ -25,7 +25,10 @@ enum Token_kind
   rbrace_tok,
   lparen_tok,
   rparen_tok,
+  lbracket_tok,
+  rbracket_tok,
   comma_tok,
+  dot_tok,
   colon_tok,
   semicolon_tok,
   equal_tok,
@@ -124,3 +124,12 @@ get_record_type(Record_decl const* r)
   auto ins = ts.emplace(r);
   return &*ins.first;
 }
+
+
+Type const*
+get_array_type(Type const* t, int n)
+{
+  static Type_set<Array_type> ts;
+  auto ins = ts.emplace(t, n);
+  return &*ins.first;
+}
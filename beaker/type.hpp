@@ -14,6 +14,7 @@
 //          int                 -- integer type
 //          (t1, ..., tn) -> t  -- function types
 //          ref t               -- reference types
+//          t[n]                -- array types
 //
 // Note that types are not mutable. Once created, a type
 // cannot be changed. The reason for this is that we
@@ -28,12 +29,32 @@ struct Type
 {
   struct Visitor;
 
+  // The kinds of types.
+  enum Kind
+  {
+    id_type,
+    boolean_type,
+    integer_type,
+    function_type,
+    reference_type,
+    record_type,
+    array_type,
+  };
+
+  Type(Kind k)
+    : kind_(k)
+  { }
+
   virtual ~Type() { }
 
   virtual void accept(Visitor&) const = 0;
 
   virtual Type const* ref() const;
   virtual Type const* nonref() const;
+
+  Kind kind() const { return kind_; }
+
+  Kind kind_;
 };
 
 
@@ -45,6 +66,7 @@ struct Type::Visitor
   virtual void visit(Function_type const*) = 0;
   virtual void visit(Reference_type const*) = 0;
   virtual void visit(Record_type const*) = 0;
+  virtual void visit(Array_type const*) = 0;
 };
 
 
@@ -53,9 +75,11 @@ struct Type::Visitor
 struct Id_type : Type
 {
   Id_type(Symbol const* s)
-    : sym_(s)
+    : Type(id_type), sym_(s)
   { }
 
+  static bool classof(Type const* t) { return t->kind() == id_type; }
+
   void accept(Visitor& v) const { v.visit(this); };
 
   Symbol const* symbol() const { return sym_; }
@@ -67,6 +91,12 @@ struct Id_type : Type
 // The type bool.
 struct Boolean_type : Type
 {
+  Boolean_type()
+    : Type(boolean_type)
+  { }
+
+  static bool classof(Type const* t) { return t->kind() == boolean_type; }
+
   void accept(Visitor& v) const { v.visit(this); };
 };
 
@@ -74,6 +104,12 @@ struct Boolean_type : Type
 // The type int.
 struct Integer_type : Type
 {
+  Integer_type()
+    : Type(integer_type)
+  { }
+
+  static bool classof(Type const* t) { return t->kind() == integer_type; }
+
   void accept(Visitor& v) const { v.visit(this); };
 };
 
@@ -82,9 +118,11 @@ struct Integer_type : Type
 struct Function_type : Type
 {
   Function_type(Type_seq const& t, Type const* r)
-    : first(t), second(r)
+    : Type(function_type), first(t), second(r)
   { }
 
+  static bool classof(Type const* t) { return t->kind() == function_type; }
+
   void accept(Visitor& v) const { v.visit(this); };
 
   Type_seq const& parameter_types() const { return first; }
@@ -99,9 +137,11 @@ struct Function_type : Type
 struct Reference_type : Type
 {
   Reference_type(Type const* t)
-    : first(t)
+    : Type(reference_type), first(t)
   { }
 
+  static bool classof(Type const* t) { return t->kind() == reference_type; }
+
   void accept(Visitor& v) const { v.visit(this); };
 
   virtual Type const* ref() const;
@@ -119,9 +159,11 @@ struct Reference_type : Type
 struct Record_type : Type
 {
   Record_type(Decl const* d)
-    : decl_(d)
+    : Type(record_type), decl_(d)
   { }
 
+  static bool classof(Type const* t) { return t->kind() == record_type; }
+
   void accept(Visitor& v) const { v.visit(this); };
 
   Record_decl const* declaration() const;
@@ -130,6 +172,27 @@ struct Record_type : Type
 };
 
 
+// The type t[n] of arrays of n objects of type t. The
+// elements are stored contiguously, and the extent is
+// always positive.
+struct Array_type : Type
+{
+  Array_type(Type const* t, int n)
+    : Type(array_type), first(t), second(n)
+  { }
+
+  static bool classof(Type const* t) { return t->kind() == array_type; }
+
+  void accept(Visitor& v) const { v.visit(this); };
+
+  Type const* type() const   { return first; }
+  int         extent() const { return second; }
+
+  Type const* first;
+  int         second;
+};
+
+
 // -------------------------------------------------------------------------- //
 //                              Type accessors
 
@@ -141,6 +204,20 @@ Type const* get_function_type(Type_seq const&, Type const*);
 Type const* get_function_type(Decl_seq const&, Type const*);
 Type const* get_reference_type(Type const*);
 Type const* get_record_type(Record_decl const*);
+Type const* get_array_type(Type const*, int);
+
+
+// -------------------------------------------------------------------------- //
+//                              Type queries
+
+// Returns true if objects of type t are aggregates:
+// records and arrays. An aggregate object occupies a
+// block of slots.
+inline bool
+is_aggregate(Type const* t)
+{
+  return t->kind() == Type::record_type || t->kind() == Type::array_type;
+}
 
 
 // -------------------------------------------------------------------------- //
@@ -159,15 +236,26 @@ struct Generic_type_visitor : Type::Visitor, lingo::Generic_visitor<F, T>
   void visit(Function_type const* t) { this->invoke(t); }
   void visit(Reference_type const* t) { this->invoke(t); }
   void visit(Record_type const* t) { this->invoke(t); }
+  void visit(Array_type const* t) { this->invoke(t); }
 };
 
 
+// Apply fn to the type t. Dispatch is by the kind of
+// the type.
 template<typename F, typename T = typename std::result_of<F(Boolean_type const*)>::type>
 inline T
 apply(Type const* t, F fn)
 {
-  Generic_type_visitor<F, T> v(fn);
-  return accept(t, v);
+  switch (t->kind()) {
+    case Type::id_type: return fn(static_cast<Id_type const*>(t));
+    case Type::boolean_type: return fn(static_cast<Boolean_type const*>(t));
+    case Type::integer_type: return fn(static_cast<Integer_type const*>(t));
+    case Type::function_type: return fn(static_cast<Function_type const*>(t));
+    case Type::reference_type: return fn(static_cast<Reference_type const*>(t));
+    case Type::record_type: return fn(static_cast<Record_type const*>(t));
+    case Type::array_type: return fn(static_cast<Array_type const*>(t));
+  }
+  throw std::logic_error("invalid type kind");
 }
 
 
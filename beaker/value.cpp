@@ -4,6 +4,252 @@
 #include "value.hpp"
 #include "decl.hpp"
 
+#include <algorithm>
+
+
+namespace
+{
+
+// The heap that owns the boxes allocated by this thread,
+// if any.
+thread_local Box_heap* current_heap = nullptr;
+
+} // namespace
+
+
+// Returns the representation of a boxed integer. Boxes
+// allocated with no current heap are owned by a heap
+// that never collects.
+std::uintptr_t
+Value::box(Integer const& n)
+{
+  static Box_heap permanent(nullptr);
+  Box_heap* h = current_heap ? current_heap : &permanent;
+  Integer const* p = h->allocate(n);
+  return reinterpret_cast<std::uintptr_t>(p) | box_tag;
+}
+
+
+// -------------------------------------------------------------------------- //
+// Equality
+
+bool
+equal_slow(Value a, Value b)
+{
+  return a.as_exact() == b.as_exact();
+}
+
+
+std::size_t
+hash_slow(Value v)
+{
+  return v.as_exact().hash();
+}
+
+
+// -------------------------------------------------------------------------- //
+// Boxes
+
+// A box is an integer and the mark of the last collection.
+// The value refers to the integer, which is at the address
+// of the box.
+struct Box_heap::Box
+{
+  Integer value;
+  bool    marked;
+};
+
+
+// Create a heap whose roots are marked by f. If f is
+// empty, the heap never collects.
+Box_heap::Box_heap(Root_fn f)
+  : roots_(f), limit_(min_limit), collections_(0), base_(nullptr)
+{ }
+
+
+Box_heap::~Box_heap()
+{
+  for (Box* b : boxes_)
+    delete b;
+}
+
+
+// Returns a new box holding n. Note that the heap collects
+// before the box is allocated, so that n need not be
+// reachable.
+Integer const*
+Box_heap::allocate(Integer const& n)
+{
+  if (roots_ && boxes_.size() >= limit_)
+    collect();
+  boxes_.push_back(new Box{n, false});
+  return &boxes_.back()->value;
+}
+
+
+// Delete the boxes that are not reachable. Callee-saved
+// registers are spilled into this frame, so that values
+// held only by registers are found on the native stack.
+void
+Box_heap::collect()
+{
+  __builtin_unwind_init();
+  std::sort(boxes_.begin(), boxes_.end());
+  for (Box* b : boxes_)
+    b->marked = false;
+  roots_(*this);
+  mark_stack();
+
+  auto live = std::partition(boxes_.begin(), boxes_.end(),
+                             [](Box* b) { return b->marked; });
+  for (auto i = live; i != boxes_.end(); ++i)
+    delete *i;
+  boxes_.erase(live, boxes_.end());
+  limit_ = std::max(2 * boxes_.size(), std::size_t(min_limit));
+  ++collections_;
+}
+
+
+// Mark the native stack from this frame, which is below
+// the frame of collect(), to the scope of the heap. Note
+// that the native stack grows down.
+__attribute__((noinline)) void
+Box_heap::mark_stack()
+{
+  if (!base_)
+    return;
+  std::uintptr_t here = 0;
+  mark_words(&here, reinterpret_cast<std::uintptr_t const*>(base_));
+}
+
+
+// Mark the boxes referred to by the values in [first, last).
+void
+Box_heap::mark(Value const* first, Value const* last)
+{
+  mark_words(&first->bits, &last->bits);
+}
+
+
+// Mark every box referred to by a word in [first, last),
+// with or without its tag. The boxes are sorted.
+void
+Box_heap::mark_words(std::uintptr_t const* first, std::uintptr_t const* last)
+{
+  if (boxes_.empty())
+    return;
+  std::uintptr_t lo = reinterpret_cast<std::uintptr_t>(boxes_.front());
+  std::uintptr_t hi = reinterpret_cast<std::uintptr_t>(boxes_.back());
+  for (; first != last; ++first) {
+    std::uintptr_t p = *first & ~Value::tag_mask;
+    if (p < lo || p > hi)
+      continue;
+    Box* b = reinterpret_cast<Box*>(p);
+    auto i = std::lower_bound(boxes_.begin(), boxes_.end(), b);
+    if (i != boxes_.end() && *i == b)
+      b->marked = true;
+  }
+}
+
+
+// -------------------------------------------------------------------------- //
+// Heap scopes
+
+Box_heap::Scope::Scope(Box_heap& h)
+  : heap_(h), prev_(current_heap), base_(h.base_)
+{
+  h.base_ = reinterpret_cast<char const*>(this);
+  current_heap = &h;
+}
+
+
+Box_heap::Scope::~Scope()
+{
+  heap_.base_ = base_;
+  current_heap = prev_;
+}
+
+
+// -------------------------------------------------------------------------- //
+// Integer arithmetic
+
+// Returns the value of n in the arithmetic mode m.
+Value
+make_integer(Arithmetic m, Integer const& n)
+{
+  if (n.is_word())
+    return n.word();
+  switch (m) {
+    case checked_arithmetic:
+      throw std::runtime_error("integer overflow");
+    case wrapping_arithmetic:
+      return n.wrap();
+    case exact_arithmetic:
+      return n;
+  }
+  throw std::logic_error("invalid arithmetic");
+}
+
+
+// When the operands are words, and the result of the
+// operation does not overflow, it is computed directly.
+// Otherwise the result is computed exactly. Note that
+// operands are always words unless arithmetic is exact.
+Value
+integer_add_slow(Arithmetic m, Value a, Value b)
+{
+  Integer_value r;
+  if (a.is_word() && b.is_word()
+      && !__builtin_add_overflow(a.as_integer(), b.as_integer(), &r))
+    return r;
+  return make_integer(m, a.as_exact() + b.as_exact());
+}
+
+
+Value
+integer_sub_slow(Arithmetic m, Value a, Value b)
+{
+  Integer_value r;
+  if (a.is_word() && b.is_word()
+      && !__builtin_sub_overflow(a.as_integer(), b.as_integer(), &r))
+    return r;
+  return make_integer(m, a.as_exact() - b.as_exact());
+}
+
+
+Value
+integer_mul_slow(Arithmetic m, Value a, Value b)
+{
+  Integer_value r;
+  if (a.is_word() && b.is_word()
+      && !__builtin_mul_overflow(a.as_integer(), b.as_integer(), &r))
+    return r;
+  return make_integer(m, a.as_exact() * b.as_exact());
+}
+
+
+// Note that the quotient of the least integer and -1
+// overflows.
+Value
+integer_div_slow(Arithmetic m, Value a, Value b)
+{
+  return make_integer(m, a.as_exact() / b.as_exact());
+}
+
+
+Value
+integer_rem_slow(Arithmetic m, Value a, Value b)
+{
+  return make_integer(m, a.as_exact() % b.as_exact());
+}
+
+
+bool
+integer_less_slow(Value a, Value b)
+{
+  return a.as_exact() < b.as_exact();
+}
+
 
 std::ostream& 
 operator<<(std::ostream& os, Value const& v)
@@ -13,7 +259,7 @@ operator<<(std::ostream& os, Value const& v)
       return os << "<error>";
 
     case integer_value:
-      return os << v.get_integer();
+      return os << v.as_exact();
 
     case function_value:
       return os << v.get_function()->name()->spelling();
@@ -10,90 +10,155 @@
 // TODO: Make a visitor for values.
 
 #include "prelude.hpp"
+#include "integer.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <vector>
 
 
 struct Value;
 
 
+// The kinds of values. Note that the enumerators are
+// also tags of the representation (see Value).
 enum Value_kind
 {
-  error_value,
-  integer_value,
-  function_value,
-  reference_value,
+  error_value     = 0,
+  integer_value   = 1,
+  function_value  = 2,
+  reference_value = 3,
 };
 
 
-using Integer_value = int;
+using Integer_value = std::int64_t;
 using Function_value = Function_decl const*;
 using Reference_value = Value*;
 
 
-union Value_rep
-{
-  Value_rep() = default;
-  Value_rep(Integer_value z) : int_(z) { }
-  Value_rep(Function_value f) : fn_(f) { }
-  Value_rep(Reference_value r) : ref_(r) { }
-
-  Integer_value   int_;
-  Function_value  fn_;
-  Reference_value ref_;
-};
-
-
 // Represents a compile time value.
+//
+// A value is a single tagged word. The low three bits
+// hold the tag of the value. Functions and references
+// are pointers to objects whose alignment is at least 8,
+// so their low bits are free for the tag. The error
+// value is 0.
+//
+// Integers that fit in 61 bits are small: they are
+// stored in the upper bits of the word. Larger integers
+// are boxed: the value points to an Integer, which is
+// either a word or, when arithmetic is exact, an integer
+// of any size. Boxes are owned by the heap that was
+// current when they were allocated (see Box_heap). Equal
+// integers may be in different boxes, so boxed integers
+// are compared by value (see equal()). A box never holds
+// a small integer.
+//
+// The get_* accessors check the kind of value and see
+// through references. The as_* accessors do neither:
+// they are used by the evaluator when the elaborator
+// has determined the type of the value.
 struct Value
 {
+  static constexpr std::uintptr_t tag_mask = 7;
+  static constexpr std::uintptr_t box_tag = 4;
+
+  static constexpr Integer_value min_small = -(Integer_value(1) << 60);
+  static constexpr Integer_value max_small = (Integer_value(1) << 60) - 1;
+
   Value()
-    : k(error_value), r()
+    : bits(0)
   { }
 
   Value(Integer_value n)
-    : k(integer_value), r(n)
+    : bits(min_small <= n && n <= max_small
+             ? (std::uintptr_t(n) << 3) | integer_value
+             : box(n))
+  { }
+
+  Value(Integer const& n)
+    : Value(n.is_word() ? Value(n.word()) : Value(box(n), 0))
+  { }
+
+  // Note that this makes values constructible from
+  // literals such as 0, which would otherwise also
+  // convert to null pointers.
+  Value(int n)
+    : Value(Integer_value(n))
   { }
 
   Value(Function_value f)
-    : k(function_value), r(f)
+    : bits(reinterpret_cast<std::uintptr_t>(f) | function_value)
   { }
 
   Value(Value* v);
 
-  Value_kind kind() const { return k; }
+  inline Value_kind kind() const;
 
   inline bool is_integer() const;
   inline bool is_function() const;
   inline bool is_reference() const;
 
+  bool is_small() const { return (bits & tag_mask) == integer_value; }
+  bool is_boxed() const { return (bits & tag_mask) == box_tag; }
+  bool is_word() const;
 
   Integer_value get_integer() const;
   Function_value get_function() const;
   Reference_value get_reference() const;
 
-  Value_kind k;
-  Value_rep r;
+  Integer_value   as_integer() const;
+  Integer         as_exact() const;
+  Function_value  as_function() const;
+  Reference_value as_reference() const;
+
+  // Returns the representation of the value. Values of
+  // the same kind are equal when their representations
+  // are equal, unless both are boxed.
+  std::uintptr_t rep() const { return bits; }
+
+  static std::uintptr_t box(Integer const&);
+
+  std::uintptr_t bits;
+
+private:
+  Value(std::uintptr_t b, int)
+    : bits(b)
+  { }
 };
 
 
+static_assert(sizeof(Value) == 8, "value is not a 64-bit word");
+
+
 // Construct a value reference. Not that reference
 // chains are not permitted. That is, v shall not
 // be a reference.
 inline
 Value::Value(Value* v)
-  : k(reference_value), r(v)
+  : bits(reinterpret_cast<std::uintptr_t>(v) | reference_value)
 {
   assert(!v->is_reference());
 }
 
 
+// Returns the kind of value.
+inline Value_kind
+Value::kind() const
+{
+  std::uintptr_t t = bits & tag_mask;
+  return t == box_tag ? integer_value : Value_kind(t);
+}
+
+
 // Returns true if the value is an integer or
 // a reference to an integer.
 inline bool
 Value::is_integer() const
 {
-  if (k == integer_value)
+  if (kind() == integer_value)
     return true;
-  if (k == reference_value && r.ref_->k == integer_value)
+  if (kind() == reference_value && as_reference()->kind() == integer_value)
     return true;
   return false;
 }
@@ -104,9 +169,9 @@ Value::is_integer() const
 inline bool
 Value::is_function() const
 {
-  if (k == function_value)
+  if (kind() == function_value)
     return true;
-  if (k == reference_value && r.ref_->k == function_value)
+  if (kind() == reference_value && as_reference()->kind() == function_value)
     return true;
   return false;
 }
@@ -116,7 +181,7 @@ Value::is_function() const
 inline bool
 Value::is_reference() const
 {
-  return k == reference_value;
+  return kind() == reference_value;
 }
 
 
@@ -126,10 +191,10 @@ Value::is_reference() const
 inline Integer_value
 Value::get_integer() const
 {
-  if (k == reference_value)
-    return r.ref_->get_integer();
-  assert(k == integer_value);
-  return r.int_;
+  if (kind() == reference_value)
+    return as_reference()->get_integer();
+  assert(kind() == integer_value);
+  return as_integer();
 }
 
 
@@ -139,10 +204,10 @@ Value::get_integer() const
 inline Function_value
 Value::get_function() const
 {
-  if (k == reference_value)
-    return r.ref_->get_function();
-  assert(k == function_value);
-  return r.fn_;
+  if (kind() == reference_value)
+    return as_reference()->get_function();
+  assert(kind() == function_value);
+  return as_function();
 }
 
 
@@ -152,8 +217,59 @@ Value::get_function() const
 inline Reference_value
 Value::get_reference() const
 {
-  assert(k == reference_value);
-  return r.ref_;
+  assert(kind() == reference_value);
+  return as_reference();
+}
+
+
+// Returns true if the value is an integer that fits
+// in a word. The value shall be an integer.
+inline bool
+Value::is_word() const
+{
+  if (is_small())
+    return true;
+  return reinterpret_cast<Integer const*>(bits & ~tag_mask)->is_word();
+}
+
+
+// Returns the integer value. The value shall be an
+// integer that fits in a word.
+inline Integer_value
+Value::as_integer() const
+{
+  if (is_small())
+    return Integer_value(std::intptr_t(bits) >> 3);
+  return reinterpret_cast<Integer const*>(bits & ~tag_mask)->word();
+}
+
+
+// Returns the integer value, of any size. The value
+// shall be an integer.
+inline Integer
+Value::as_exact() const
+{
+  if (is_small())
+    return Integer_value(std::intptr_t(bits) >> 3);
+  return *reinterpret_cast<Integer const*>(bits & ~tag_mask);
+}
+
+
+// Returns the function value. The value shall be
+// a function.
+inline Function_value
+Value::as_function() const
+{
+  return reinterpret_cast<Function_value>(bits & ~tag_mask);
+}
+
+
+// Returns the reference value. The value shall be
+// a reference.
+inline Reference_value
+Value::as_reference() const
+{
+  return reinterpret_cast<Reference_value>(bits & ~tag_mask);
 }
 
 
@@ -161,6 +277,200 @@ Value::get_reference() const
 using Value_seq = std::vector<Value>;
 
 
+// -------------------------------------------------------------------------- //
+// Integer arithmetic
+
+// The arithmetic mode determines the result of integer
+// operations that overflow a word. Checked arithmetic
+// fails with an error. Wrapping arithmetic produces the
+// result modulo 2^64. Exact arithmetic produces the
+// result, whatever its size. In any mode, division by 0
+// fails.
+enum Arithmetic
+{
+  checked_arithmetic,
+  wrapping_arithmetic,
+  exact_arithmetic,
+};
+
+
+Value make_integer(Arithmetic, Integer const&);
+
+Value integer_add_slow(Arithmetic, Value, Value);
+Value integer_sub_slow(Arithmetic, Value, Value);
+Value integer_mul_slow(Arithmetic, Value, Value);
+Value integer_div_slow(Arithmetic, Value, Value);
+Value integer_rem_slow(Arithmetic, Value, Value);
+bool  integer_less_slow(Value, Value);
+
+
+// Each operation has a fast path for small operands,
+// whose results fit in a word. Operations on other
+// integers are out of line.
+inline Value
+integer_add(Arithmetic m, Value a, Value b)
+{
+  if (a.is_small() && b.is_small())
+    return a.as_integer() + b.as_integer();
+  return integer_add_slow(m, a, b);
+}
+
+
+inline Value
+integer_sub(Arithmetic m, Value a, Value b)
+{
+  if (a.is_small() && b.is_small())
+    return a.as_integer() - b.as_integer();
+  return integer_sub_slow(m, a, b);
+}
+
+
+inline Value
+integer_mul(Arithmetic m, Value a, Value b)
+{
+  Integer_value r;
+  if (a.is_small() && b.is_small()
+      && !__builtin_mul_overflow(a.as_integer(), b.as_integer(), &r))
+    return r;
+  return integer_mul_slow(m, a, b);
+}
+
+
+inline Value
+integer_neg(Arithmetic m, Value a)
+{
+  return integer_sub(m, 0, a);
+}
+
+
+inline Value
+integer_div(Arithmetic m, Value a, Value b)
+{
+  if (a.is_small() && b.is_small() && b.as_integer() != 0)
+    return a.as_integer() / b.as_integer();
+  return integer_div_slow(m, a, b);
+}
+
+
+inline Value
+integer_rem(Arithmetic m, Value a, Value b)
+{
+  if (a.is_small() && b.is_small() && b.as_integer() != 0)
+    return a.as_integer() % b.as_integer();
+  return integer_rem_slow(m, a, b);
+}
+
+
+// Returns true if a is less than b.
+inline bool
+integer_less(Value a, Value b)
+{
+  if (a.is_small() && b.is_small())
+    return a.as_integer() < b.as_integer();
+  return integer_less_slow(a, b);
+}
+
+
+// -------------------------------------------------------------------------- //
+// Equality
+
+bool        equal_slow(Value, Value);
+std::size_t hash_slow(Value);
+
+
+// Returns true if the values a and b, which shall have
+// the same type, are equal. Values are equal when their
+// representations are, except that boxed integers are
+// compared by value.
+inline bool
+equal(Value a, Value b)
+{
+  if (a.rep() == b.rep())
+    return true;
+  return a.is_boxed() && b.is_boxed() && equal_slow(a, b);
+}
+
+
+// Returns a hash of v that is the same for equal values.
+inline std::size_t
+hash(Value v)
+{
+  if (v.is_boxed())
+    return hash_slow(v);
+  return std::hash<std::uintptr_t>()(v.rep());
+}
+
+
+// -------------------------------------------------------------------------- //
+// Boxes
+
+// A heap owns the boxes allocated while it is current on
+// a thread. When its number of boxes has doubled since it
+// last collected, the heap deletes every box that is not
+// reachable from its roots. The owner of the heap marks
+// the roots by giving each range of values that holds them
+// to mark(). The native stack of the thread, up to the
+// scope that made the heap current, is also marked, which
+// keeps the boxes of temporary values. Marking is
+// conservative: any word that could refer to a box keeps
+// it, so a range may also hold uninitialized values.
+//
+// Boxes allocated on a thread with no current heap are
+// never deleted.
+class Box_heap
+{
+public:
+  class Scope;
+  using Root_fn = std::function<void(Box_heap&)>;
+
+  explicit Box_heap(Root_fn);
+  ~Box_heap();
+
+  Box_heap(Box_heap const&) = delete;
+  Box_heap& operator=(Box_heap const&) = delete;
+
+  Integer const* allocate(Integer const&);
+  void           mark(Value const*, Value const*);
+
+  std::size_t size() const        { return boxes_.size(); }
+  std::size_t collections() const { return collections_; }
+
+  static constexpr std::size_t min_limit = 1 << 16;
+
+private:
+  struct Box;
+
+  void collect();
+  void mark_stack();
+  void mark_words(std::uintptr_t const*, std::uintptr_t const*);
+
+  Root_fn           roots_;
+  std::vector<Box*> boxes_;       // Sorted when collecting
+  std::size_t       limit_;       // Collect on reaching this size
+  std::size_t       collections_;
+  char const*       base_;        // The scope on the native stack
+};
+
+
+// Makes a heap current on this thread for the lifetime
+// of the scope. The native stack below the scope is
+// marked when the heap collects.
+class Box_heap::Scope
+{
+public:
+  explicit Scope(Box_heap&);
+  ~Scope();
+
+  Scope(Scope const&) = delete;
+  Scope& operator=(Scope const&) = delete;
+
+private:
+  Box_heap&   heap_;
+  Box_heap*   prev_;
+  char const* base_;
+};
+
+
 // Streaming
 std::ostream& operator<<(std::ostream& os, Value const&);
 